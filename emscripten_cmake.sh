@@ -1,5 +1,7 @@
 #!/bin/bash
 
 # This script needs the variable EMSDK to be set to the path of the emsdk directory.
+# Further arguments are passed on to cmake, for instance
+# -DPLANES_WASM_SIMD=ON for the flavor with SIMD.
 mkdir -p emscripten_build && cd emscripten_build
-cmake -DCMAKE_TOOLCHAIN_FILE=$EMSDK/upstream/emscripten/cmake/Modules/Platform/Emscripten.cmake -DCMAKE_BUILD_TYPE=Debug -G "Ninja" ..
+cmake -DCMAKE_TOOLCHAIN_FILE=$EMSDK/upstream/emscripten/cmake/Modules/Platform/Emscripten.cmake -DCMAKE_BUILD_TYPE=Debug -G "Ninja" "$@" ..
@@ -0,0 +1,272 @@
+#include "AiPilots.h"
+
+#include "Bullet.h"
+#include "DrawingUtilities.h"
+#include "Plane.h"
+#include "Simulation.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace { // unnamed
+
+    constexpr float searchRadius = 300.0f;      ///< distance within which pilots look for targets
+    constexpr float threatRadius = 250.0f;      ///< distance within which a plane that points at a pilot is a threat
+    constexpr float avoidRadius = 60.0f;        ///< distance at which pilots break away to avoid a collision
+    constexpr float threatCosine = 0.94f;       ///< cosine of the angle within which a plane points at a pilot
+    constexpr float targetRadius = 16.0f;       ///< how large a plane looks to a pilot that aims at it
+    constexpr std::size_t staggerSlots = 16;    ///< number of groups of pilots that take turns thinking
+    constexpr double patience = 3.0;            ///< seconds without a shot after which a pilot extends
+    constexpr double extendTime = 1.0;          ///< seconds that a pilot flies straight on to extend
+
+    Angle65536 GetAngle( Vector2 vector)
+    {
+        constexpr float pi = 3.14159265f;
+        return Angle65536::FromUnits( static_cast<std::uint16_t>( std::lround( std::atan2( vector.y, vector.x) * 32768.0f / pi)));
+    }
+
+    /// The shortest vector from 'from' to 'to' in the wrapping world.
+    Vector2 GetOffset( Vector2 from, Vector2 to, const WorldBounds &world)
+    {
+        return {
+            WrapDifference( to.x - from.x, static_cast<float>( world.width)),
+            WrapDifference( to.y - from.y, static_cast<float>( world.height))};
+    }
+
+    /**
+     * The time after which a bullet fired now with speed 'bulletSpeed' can
+     * meet a target at 'offset' that moves with 'targetVelocity', or a
+     * negative value if it can't.
+     */
+    float GetInterceptTime( Vector2 offset, Vector2 targetVelocity, float bulletSpeed)
+    {
+        // Solve |offset + targetVelocity * t| = bulletSpeed * t for t.
+        const float a = Vector2DotProduct( targetVelocity, targetVelocity) - bulletSpeed * bulletSpeed;
+        const float b = 2.0f * Vector2DotProduct( offset, targetVelocity);
+        const float c = Vector2DotProduct( offset, offset);
+        if (std::abs( a) < 1e-3f)
+        {
+            return b < 0.0f ? -c / b : -1.0f;
+        }
+
+        const float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < 0.0f)
+        {
+            return -1.0f;
+        }
+        const float root = std::sqrt( discriminant);
+        const float t1 = (-b - root) / (2.0f * a);
+        const float t2 = (-b + root) / (2.0f * a);
+        const float first = std::min( t1, t2);
+        return first > 0.0f ? first : std::max( t1, t2);
+    }
+}
+
+AiPilots::AiPilots( float thinkInterval)
+    : thinkInterval( thinkInterval)
+{
+}
+
+void AiPilots::AddPilot( std::size_t planeIndex)
+{
+    if (planeIndex >= pilotOfPlane.size())
+    {
+        pilotOfPlane.resize( planeIndex + 1, none);
+    }
+    if (pilotOfPlane[planeIndex] != none)
+    {
+        return;
+    }
+
+    // Spread the thinking of the pilots over the think interval.
+    const auto slot = pilots.size() % staggerSlots;
+    pilotOfPlane[planeIndex] = static_cast<std::uint32_t>( pilots.size());
+    pilots.push_back( { static_cast<std::uint32_t>( planeIndex), thinkInterval * slot / staggerSlots});
+}
+
+bool AiPilots::HasPilot( std::size_t planeIndex) const
+{
+    return planeIndex < pilotOfPlane.size() and pilotOfPlane[planeIndex] != none;
+}
+
+void AiPilots::Think( const Simulation &simulation)
+{
+    const auto time = simulation.GetTime();
+    for (auto &pilot : pilots)
+    {
+        if (time < pilot.nextThink)
+        {
+            continue;
+        }
+
+        Think( pilot, simulation, time);
+        pilot.nextThink += thinkInterval;
+        if (pilot.nextThink < time)
+        {
+            // Don't try to catch up after a pause.
+            pilot.nextThink = time + thinkInterval;
+        }
+    }
+}
+
+void AiPilots::Think( Pilot &pilot, const Simulation &simulation, double time) const
+{
+    const auto &planes = simulation.GetPlanes();
+    const auto &world = simulation.GetBounds();
+    const auto &plane = planes[pilot.plane];
+
+    pilot.wantsToFire = false;
+    pilot.heading = plane.GetFinePitch();
+    if (plane.GetState() != Plane::Flying and plane.GetState() != Plane::Newborn)
+    {
+        pilot.lastShot = time;
+        return;
+    }
+
+    if (time < pilot.extendUntil)
+    {
+        return;
+    }
+    if (time - pilot.lastShot > patience + 0.25 * (pilot.plane % 4))
+    {
+        // Not every pilot loses patience at the same time, or two pilots in
+        // a stalemate would just extend together.
+        pilot.extendUntil = time + extendTime;
+        pilot.lastShot = pilot.extendUntil;
+        return;
+    }
+
+    pilot.target = FindTarget( pilot, simulation);
+    if (pilot.target == none)
+    {
+        return;
+    }
+
+    const auto &target = planes[pilot.target];
+    const auto offset = GetOffset( plane.GetPosition(), target.GetPosition(), world);
+    const float distanceSquared = Vector2DotProduct( offset, offset);
+
+    // Is the target pointing at us from close by?
+    const auto targetVelocity = target.GetSpeedVector();
+    const float pointing = -Vector2DotProduct( targetVelocity, offset);
+    const bool threatened =
+        distanceSquared < threatRadius * threatRadius
+        and pointing > 0.0f
+        and pointing * pointing > threatCosine * threatCosine * Vector2DotProduct( targetVelocity, targetVelocity) * distanceSquared;
+
+    if (threatened or distanceSquared < avoidRadius * avoidRadius)
+    {
+        // Break away at a right angle to the line between the planes, to
+        // whichever side is closest to the current heading.
+        constexpr std::int32_t quarterTurn = Angle65536::unitsPerTurn / 4;
+        auto left = GetAngle( offset);
+        auto right = left;
+        left += -quarterTurn;
+        right += quarterTurn;
+        const auto toLeft = std::abs( left - plane.GetFinePitch());
+        const auto toRight = std::abs( right - plane.GetFinePitch());
+        pilot.heading = toLeft < toRight ? left : right;
+        return;
+    }
+
+    // Lead the target: aim where the bullets would meet it.
+    const float bulletSpeed = 2.0f * plane.GetSpeed();
+    const float interceptTime = GetInterceptTime( offset, targetVelocity, bulletSpeed);
+    const auto aim = interceptTime > 0.0f ? offset + targetVelocity * interceptTime : offset;
+    pilot.heading = GetAngle( aim);
+
+    // The closer the target, the further off the plane can point and still hit.
+    constexpr float pi = 3.14159265f;
+    const float aimDistance = std::sqrt( Vector2DotProduct( aim, aim));
+    pilot.fireTolerance = static_cast<std::int32_t>( std::clamp(
+        std::atan2( targetRadius, aimDistance) * 32768.0f / pi, 256.0f, 4096.0f));
+    pilot.wantsToFire =
+        target.GetState() == Plane::Flying
+        and interceptTime > 0.0f
+        and interceptTime < 0.9f * Bullet::lifeTime;
+
+    const auto error = pilot.heading - plane.GetFinePitch();
+    if (pilot.wantsToFire and std::abs( error) <= pilot.fireTolerance)
+    {
+        pilot.lastShot = time;
+    }
+}
+
+std::uint32_t AiPilots::FindTarget( const Pilot &pilot, const Simulation &simulation) const
+{
+    const auto &planes = simulation.GetPlanes();
+    const auto &world = simulation.GetBounds();
+    const auto position = planes[pilot.plane].GetPosition();
+
+    auto nearest = none;
+    float nearestDistance = std::numeric_limits<float>::max();
+    const auto consider = [&]( std::uint32_t index)
+    {
+        if (index == pilot.plane or planes[index].GetState() != Plane::Flying)
+        {
+            return;
+        }
+        const auto offset = GetOffset( position, planes[index].GetPosition(), world);
+        const float distance = Vector2DotProduct( offset, offset);
+        if (distance < nearestDistance)
+        {
+            nearest = index;
+            nearestDistance = distance;
+        }
+    };
+
+    simulation.GetCollisionPipeline().Query(
+        CollisionLayer::Planes,
+        { position.x - searchRadius, position.y - searchRadius, 2 * searchRadius, 2 * searchRadius},
+        consider);
+    if (nearest != none)
+    {
+        return nearest;
+    }
+
+    // Nobody nearby. Stay with the previous target if there is one, else
+    // look further.
+    if (pilot.target != none and pilot.target < planes.size() and planes[pilot.target].GetState() == Plane::Flying)
+    {
+        return pilot.target;
+    }
+    for (std::uint32_t index = 0; index < planes.size(); ++index)
+    {
+        consider( index);
+    }
+    return nearest;
+}
+
+PlaneInput AiPilots::GetInput( std::size_t planeIndex, float deltaTime, const Plane &plane) const
+{
+    return HasPilot( planeIndex) ? GetInput( pilots[pilotOfPlane[planeIndex]], deltaTime, plane) : PlaneInput{};
+}
+
+void AiPilots::GetInputs( std::span<const Plane> planes, float deltaTime, std::span<PlaneInput> inputs) const
+{
+    for (const auto &pilot : pilots)
+    {
+        if (pilot.plane < planes.size() and pilot.plane < inputs.size())
+        {
+            inputs[pilot.plane] = GetInput( pilot, deltaTime, planes[pilot.plane]);
+        }
+    }
+}
+
+PlaneInput AiPilots::GetInput( const Pilot &pilot, float deltaTime, const Plane &plane)
+{
+    // Turn as fast as a human player can, and fire if the plane points close
+    // enough to the aim once it has turned.
+    const auto turn = static_cast<std::int32_t>( std::lround( Plane::turnRate * deltaTime));
+    std::int32_t error = pilot.heading - plane.GetFinePitch();
+    PlaneInput input;
+    if (std::abs( error) > turn / 2)
+    {
+        input.turn = error > 0 ? 1 : -1;
+        error -= input.turn * turn;
+    }
+    input.fire = pilot.wantsToFire and std::abs( error) <= pilot.fireTolerance;
+    return input;
+}
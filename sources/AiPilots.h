@@ -0,0 +1,81 @@
+#ifndef AI_PILOTS_H
+#define AI_PILOTS_H
+
+#include "Angle65536.h"
+#include "PlaneInput.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class Plane;
+class Simulation;
+
+/**
+ * Computer pilots that pursue, evade and shoot at other planes.
+ *
+ * Pilots think in two steps, to stay cheap when there are hundreds of them:
+ * Think() runs once per tick for all pilots together and lets each pilot
+ * decide on a heading and whether to shoot, but every pilot only thinks once
+ * per thinkInterval and the pilots take turns. Targets are found through the
+ * grid of the collision pipeline, so a pilot only looks at nearby planes. Then
+ * GetInput() turns the decision into the input for a single plane, every tick,
+ * which is only a few comparisons. GetInputs() does the same for all planes
+ * with a pilot at once.
+ *
+ * A pilot picks the nearest flying plane as its target. If that plane points
+ * at it from close by, or if it gets so close that the planes would collide,
+ * the pilot breaks away. Otherwise, it aims at the point where its bullets
+ * would meet the target if the target kept its course, and fires when its
+ * plane points there and the bullets would get there in time. Two pilots that
+ * chase each other can end up turning in circles forever, so a pilot that has
+ * not had a shot for a while flies straight on for a moment.
+ */
+class AiPilots
+{
+public:
+    explicit AiPilots( float thinkInterval = 0.1f);
+
+    /// Let a computer pilot fly the plane with the given index.
+    void AddPilot( std::size_t planeIndex);
+    bool HasPilot( std::size_t planeIndex) const;
+
+    /// Let the pilots whose turn it is decide what to do.
+    void Think( const Simulation &simulation);
+
+    /**
+     * Turn the plane towards the heading that its pilot chose and fire when
+     * the pilot wants to and the plane points in the right direction. Planes
+     * without a pilot get an input that does nothing.
+     */
+    PlaneInput GetInput( std::size_t planeIndex, float deltaTime, const Plane &plane) const;
+
+    /// Fill in the inputs of all planes that have a pilot, leaving the others as they are.
+    void GetInputs( std::span<const Plane> planes, float deltaTime, std::span<PlaneInput> inputs) const;
+
+private:
+    static constexpr std::uint32_t none = ~std::uint32_t{ 0};
+
+    struct Pilot
+    {
+        std::uint32_t   plane;
+        double          nextThink;
+        std::uint32_t   target = none;
+        Angle65536      heading = {};
+        std::int32_t    fireTolerance = 0;  ///< how far, in Angle65536 units, the plane may point off the aim when firing
+        bool            wantsToFire = false;
+        double          lastShot = 0.0;     ///< last time the pilot had a shot at a target
+        double          extendUntil = 0.0;  ///< fly straight on until this time, to get out of a stalemate
+    };
+
+    void Think( Pilot &pilot, const Simulation &simulation, double time) const;
+    static PlaneInput GetInput( const Pilot &pilot, float deltaTime, const Plane &plane);
+    std::uint32_t FindTarget( const Pilot &pilot, const Simulation &simulation) const;
+
+    float                       thinkInterval;
+    std::vector<Pilot>          pilots;
+    std::vector<std::uint32_t>  pilotOfPlane;   ///< index in pilots, per plane
+};
+
+#endif // AI_PILOTS_H
@@ -0,0 +1,188 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::size_t> allocationCount{ 0};
+    std::atomic<std::size_t> deallocationCount{ 0};
+    std::atomic<std::size_t> allocatedBytes{ 0};
+
+#if defined( PLANES_TRACK_ALLOCATIONS)
+    void *CountedAllocate( std::size_t size, std::size_t alignment = 0)
+    {
+        allocationCount.fetch_add( 1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add( size, std::memory_order_relaxed);
+
+        // malloc(0) may return a null pointer, operator new(0) may not.
+        if (size == 0)
+        {
+            size = 1;
+        }
+
+        void *result = nullptr;
+        if (alignment > alignof( std::max_align_t))
+        {
+            // aligned_alloc requires the size to be a multiple of the alignment.
+            result = std::aligned_alloc( alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        else
+        {
+            result = std::malloc( size);
+        }
+        return result;
+    }
+
+    void CountedFree( void *pointer)
+    {
+        if (pointer)
+        {
+            deallocationCount.fetch_add( 1, std::memory_order_relaxed);
+            std::free( pointer);
+        }
+    }
+#endif // PLANES_TRACK_ALLOCATIONS
+}
+
+#if defined( PLANES_TRACK_ALLOCATIONS)
+
+// Replacements of the global allocation functions. The array versions and the
+// remaining delete overloads of the standard library forward to these.
+
+void *operator new( std::size_t size)
+{
+    if (auto pointer = CountedAllocate( size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new( std::size_t size, std::align_val_t alignment)
+{
+    if (auto pointer = CountedAllocate( size, static_cast<std::size_t>(alignment)))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new( std::size_t size, const std::nothrow_t &) noexcept
+{
+    return CountedAllocate( size);
+}
+
+void *operator new[]( std::size_t size)
+{
+    return operator new( size);
+}
+
+void *operator new[]( std::size_t size, std::align_val_t alignment)
+{
+    return operator new( size, alignment);
+}
+
+void *operator new[]( std::size_t size, const std::nothrow_t &) noexcept
+{
+    return CountedAllocate( size);
+}
+
+void operator delete( void *pointer) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete( void *pointer, std::size_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete( void *pointer, std::align_val_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete( void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete[]( void *pointer) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete[]( void *pointer, std::size_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete[]( void *pointer, std::align_val_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+void operator delete[]( void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    CountedFree( pointer);
+}
+
+#endif // PLANES_TRACK_ALLOCATIONS
+
+AllocationCounts GetAllocationCounts()
+{
+    return {
+        allocationCount.load( std::memory_order_relaxed),
+        deallocationCount.load( std::memory_order_relaxed),
+        allocatedBytes.load( std::memory_order_relaxed)};
+}
+
+const char *GetPhaseName( FramePhase phase)
+{
+    switch (phase)
+    {
+        case FramePhase::Mechanics:     return "mechanics";
+        case FramePhase::Controls:      return "controls";
+        case FramePhase::Physics:       return "physics";
+        case FramePhase::Collisions:    return "collisions";
+        case FramePhase::Sound:         return "sound";
+        case FramePhase::Draw:          return "draw";
+        case FramePhase::Count:         break;
+    }
+    return "unknown";
+}
+
+void AllocationTracker::BeginFrame()
+{
+    currentPhases = {};
+    currentPhase = FramePhase::Mechanics;
+    frameStart = GetAllocationCounts();
+    phaseStart = frameStart;
+}
+
+void AllocationTracker::BeginPhase( FramePhase phase)
+{
+    ClosePhase();
+    currentPhase = phase;
+}
+
+void AllocationTracker::EndFrame()
+{
+    ClosePhase();
+    lastPhases = currentPhases;
+    lastFrame = phaseStart - frameStart;
+
+    if (frameCount >= warmupFrames and lastFrame.allocations != 0)
+    {
+        ++allocatingFrameCount;
+    }
+    ++frameCount;
+}
+
+void AllocationTracker::ClosePhase()
+{
+    const auto now = GetAllocationCounts();
+    currentPhases[static_cast<std::size_t>(currentPhase)] += now - phaseStart;
+    phaseStart = now;
+}
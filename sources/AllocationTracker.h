@@ -0,0 +1,118 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <array>
+#include <cstddef>
+
+/**
+ * Heap allocation counters.
+ *
+ * Only allocations that go through the global operator new and delete are
+ * counted. Memory that raylib allocates through malloc() is not.
+ */
+struct AllocationCounts
+{
+    std::size_t allocations = 0;
+    std::size_t deallocations = 0;
+    std::size_t bytes = 0; ///< number of bytes requested by the allocations
+};
+
+inline AllocationCounts operator-( const AllocationCounts &lhs, const AllocationCounts &rhs)
+{
+    return {
+        lhs.allocations - rhs.allocations,
+        lhs.deallocations - rhs.deallocations,
+        lhs.bytes - rhs.bytes};
+}
+
+inline AllocationCounts &operator+=( AllocationCounts &lhs, const AllocationCounts &rhs)
+{
+    lhs.allocations += rhs.allocations;
+    lhs.deallocations += rhs.deallocations;
+    lhs.bytes += rhs.bytes;
+    return lhs;
+}
+
+/**
+ * The phases of a single frame, in the order in which the game executes them.
+ */
+enum class FramePhase
+{
+    Mechanics,
+    Controls,
+    Physics,
+    Collisions,
+    Sound,
+    Draw,
+    Count
+};
+
+const char *GetPhaseName( FramePhase phase);
+
+/**
+ * Returns the allocation counts since the start of the program.
+ *
+ * These counts are only maintained when the game is built with
+ * PLANES_TRACK_ALLOCATIONS (cmake -DPLANES_TRACK_ALLOCATIONS=ON), in which case
+ * the global operator new and delete are replaced by counting versions.
+ * Otherwise, all counts stay zero.
+ */
+AllocationCounts GetAllocationCounts();
+
+/**
+ * Attributes heap allocations to frames and to the phases within a frame.
+ *
+ * Call BeginFrame() at the start of a frame, BeginPhase() whenever the game
+ * moves on to a next phase and EndFrame() when the frame is complete. All
+ * allocations between two calls are attributed to the phase that was started
+ * last. The counts of the most recently completed frame remain available until
+ * the next frame ends.
+ */
+class AllocationTracker
+{
+public:
+#if defined( PLANES_TRACK_ALLOCATIONS)
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    void BeginFrame();
+    void BeginPhase( FramePhase phase);
+    void EndFrame();
+
+    /// Counts of the last completed frame.
+    const AllocationCounts &GetFrameCounts() const { return lastFrame; }
+
+    /// Counts of the given phase in the last completed frame.
+    const AllocationCounts &GetPhaseCounts( FramePhase phase) const
+    {
+        return lastPhases[static_cast<std::size_t>(phase)];
+    }
+
+    /// Number of completed frames.
+    std::size_t GetFrameCount() const { return frameCount; }
+
+    /// Number of completed frames that did any heap allocation.
+    std::size_t GetAllocatingFrameCount() const { return allocatingFrameCount; }
+
+    /// Ignore allocations in frames before this one when counting allocating frames.
+    void SetWarmupFrames( std::size_t frames) { warmupFrames = frames; }
+
+private:
+    using PhaseCounts = std::array<AllocationCounts, static_cast<std::size_t>(FramePhase::Count)>;
+
+    void ClosePhase();
+
+    FramePhase          currentPhase = FramePhase::Mechanics;
+    AllocationCounts    phaseStart;
+    AllocationCounts    frameStart;
+    PhaseCounts         currentPhases;
+    PhaseCounts         lastPhases;
+    AllocationCounts    lastFrame;
+    std::size_t         frameCount = 0;
+    std::size_t         allocatingFrameCount = 0;
+    std::size_t         warmupFrames = 0;
+};
+
+#endif // ALLOCATION_TRACKER_H
@@ -0,0 +1,69 @@
+#ifndef ANGLE65536_H
+#define ANGLE65536_H
+
+#include "Angle256.h"
+
+#include <cstdint>
+#include <span>
+
+/**
+ * An angle in units of 1/65536 of a full turn, about 0.0055 degrees.
+ *
+ * Angles wrap around like the 16-bit integer they are. An Angle256 converts
+ * to the same angle implicitly, so code that works in Angle256 units can pass
+ * its angles on unchanged.
+ */
+class Angle65536
+{
+public:
+    static constexpr std::int32_t unitsPerTurn = 65536;
+
+    constexpr Angle65536() = default;
+    constexpr Angle65536( Angle256 angle) : units( static_cast<std::uint16_t>( angle << 8)) {}
+
+    static constexpr Angle65536 FromUnits( std::uint16_t units)
+    {
+        Angle65536 angle;
+        angle.units = units;
+        return angle;
+    }
+
+    constexpr std::uint16_t GetUnits() const { return units; }
+
+    /// The nearest Angle256.
+    constexpr Angle256 ToAngle256() const { return static_cast<Angle256>( (units + 128) >> 8); }
+
+    /// Turn by the given number of units.
+    constexpr Angle65536 &operator+=( std::int32_t delta)
+    {
+        units = static_cast<std::uint16_t>( units + delta);
+        return *this;
+    }
+
+    constexpr Angle65536 operator-() const { return FromUnits( static_cast<std::uint16_t>( -units)); }
+
+    /// The shortest turn from 'other' to this angle, in units.
+    constexpr std::int16_t operator-( Angle65536 other) const { return static_cast<std::int16_t>( units - other.units); }
+
+    friend constexpr bool operator==( Angle65536, Angle65536) = default;
+
+private:
+    std::uint16_t units = 0;
+};
+
+// Returns the cosine of the given Angle65536 value, interpolated in a table.
+float cos( Angle65536 angle);
+
+// Returns the sine of the given Angle65536 value, interpolated in a table.
+float sin( Angle65536 angle);
+
+/**
+ * Compute the sines and cosines of all angles in one pass, with exactly the
+ * results of sin() and cos(). The loop has no branches, so that compilers
+ * can vectorize it.
+ *
+ * The spans of sines and cosines must be at least as long as that of angles.
+ */
+void SinCos( std::span<const Angle65536> angles, std::span<float> sines, std::span<float> cosines);
+
+#endif // ANGLE65536_H
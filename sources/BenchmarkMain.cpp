@@ -0,0 +1,42 @@
+#include "StressHarness.h"
+#include "raylib.h"
+
+#include <cstdlib>
+#include <string_view>
+
+/**
+ * Entry point of planes_bench, which only runs stress scenarios headless, as
+ * the game does with --scenario. Unlike the game, it needs no window, audio
+ * or browser, so that the WebAssembly build of the simulation can be measured
+ * under node:
+ *
+ *     node planes_bench.js scenarios/bullets_50k.cfg --csv bullets_50k.csv
+ */
+int main( int argc, char *argv[])
+{
+    const char *scenarioPath = nullptr;
+    const char *csvPath = nullptr;
+    for (int argument = 1; argument < argc; ++argument)
+    {
+        const std::string_view option = argv[argument];
+        if (option == "--csv" and argument + 1 < argc)
+        {
+            csvPath = argv[++argument];
+        }
+        else if (not scenarioPath)
+        {
+            scenarioPath = argv[argument];
+        }
+        else
+        {
+            TraceLog( LOG_WARNING, "Ignoring argument %s", argv[argument]);
+        }
+    }
+
+    if (not scenarioPath)
+    {
+        TraceLog( LOG_ERROR, "Usage: planes_bench <scenario file> [--csv <file>]");
+        return EXIT_FAILURE;
+    }
+    return RunScenario( scenarioPath, csvPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
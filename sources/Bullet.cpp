@@ -1,37 +1,50 @@
 #include "Bullet.h"
 #include "DrawingUtilities.h"
-#include "GameWindow.h"
+#include "Float4.h"
 #include "VectorMath.h"
+#include "WrapRenderer.h"
 
 
 Bullet::Bullet(Color color, int owner, Vector2 position, Vector2 speed)
     : color(color), owner(owner), position(position), speed(speed) {}
 
-bool Bullet::Update(const GameWindow &window, float deltaTime)
+void Bullet::Update(const WorldBounds &world, float deltaTime)
 {
-    position += speed * deltaTime;
+    displacement = speed * deltaTime;
+    position += displacement;
     position = {
-        Wrap(position.x, static_cast<float>(window.width)),
-        Wrap(position.y, static_cast<float>(window.height))};
-    return (lifeTime -= deltaTime) > 0;
+        Wrap(position.x, static_cast<float>(world.width)),
+        Wrap(position.y, static_cast<float>(world.height))};
 }
 
-void Bullet::Draw( const GameWindow &) const
+void Bullet::Draw( WrapRenderer &renderer) const
 {
-    DrawCircleV(position, 4, color);
+    renderer.AddCircle(position, radius, color);
 }
 
-void Update( Bullets &bullets, const GameWindow &window, float deltaTime)
+void Update( Bullets &bullets, const WorldBounds &world, float deltaTime)
 {
-    for (auto it = bullets.begin(); it != bullets.end();)
+    std::size_t index = 0;
+#if defined( PLANES_SIMD)
+    // Bullet::Update() for two bullets at a time, with the x and y of both in
+    // one vector.
+    const auto width = static_cast<float>( world.width);
+    const auto height = static_cast<float>( world.height);
+    const Float4 worldSize = { width, height, width, height};
+    for (; index + 1 < bullets.size(); index += 2)
     {
-        if (!it->Update(window, deltaTime))
-        {
-            it = bullets.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+        auto &first = bullets[index];
+        auto &second = bullets[index + 1];
+        const Float4 displacement = Combine( first.speed, second.speed) * deltaTime;
+        const Float4 position = Wrap( Combine( first.position, second.position) + displacement, worldSize);
+        first.displacement = GetLow( displacement);
+        second.displacement = GetHigh( displacement);
+        first.position = GetLow( position);
+        second.position = GetHigh( position);
+    }
+#endif
+    for (; index < bullets.size(); ++index)
+    {
+        bullets[index].Update( world, deltaTime);
     }
 }
@@ -2,30 +2,49 @@
 #define BULLET_H
 
 #include "raylib.h"
+#include "WorldBounds.h"
 
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
 
-class GameWindow;
+class WrapRenderer;
+class Bullet;
+
+using Bullets = std::pmr::vector<Bullet>;
+
+/// Move all bullets, see Bullet::Update().
+void Update( Bullets &bullets, const WorldBounds &world, float deltaTime);
+
 class Bullet
 {
 public:
+    static constexpr float radius = 4.0f;
+    static constexpr float lifeTime = 2.0f; ///< seconds until the simulation removes a bullet
+
     Bullet(Color color, int owner, Vector2 position, Vector2 speed);
 
-    bool Update(const GameWindow &window, float deltaTime);
-    void Draw( const GameWindow &) const;
+    void Update(const WorldBounds &world, float deltaTime);
+    void Draw( WrapRenderer &renderer) const;
     int GetOwner() const { return owner; }
+
+    /// Bullets are numbered in the order in which they enter the simulation.
+    std::uint64_t GetSerial() const { return serial; }
+    void SetSerial( std::uint64_t serial) { this->serial = serial; }
     friend Vector2 GetPosition( const Bullet &bullet) { return bullet.position; }
 
+    /// The distance travelled during the last update, before wrapping.
+    friend Vector2 GetDisplacement( const Bullet &bullet) { return bullet.displacement; }
+    friend Vector2 GetSpeed( const Bullet &bullet) { return bullet.speed; }
+    friend void Update( Bullets &bullets, const WorldBounds &world, float deltaTime);
+
 private:
     Color color = PURPLE;
     int owner;
     Vector2 position;
     Vector2 speed;
-
-    float lifeTime = 2.0f;
+    Vector2 displacement = { 0, 0 };
+    std::uint64_t serial = 0;
 };
 
-using Bullets = std::vector<Bullet>;
-void Update( Bullets &bullets, const GameWindow &window, float deltaTime);
-
 #endif // BULLET_H
@@ -1,117 +1,229 @@
 #include "CloudSystem.h"
 #include "DrawingUtilities.h"
-#include "GameWindow.h"
 #include "raylib.h"
 #include "VectorMath.h"
+#include "Viewport.h"
+#include "WrapRenderer.h"
 
 
+#include <algorithm>
 #include <cmath>
+#include <span>
+#include <utility>
 
 
 namespace
 {
-    Vector2 Scale( const Vector2& scale, const Vector2& position)
+    // get a random value between 0 and 1.
+    float GetRandomFraction()
     {
-        return { Wrap( position.x * scale.x, 1.0f), Wrap( position.y * scale.y, 1.0f) };
+        const int randomScale = 4096;
+        return GetRandomValue(0, randomScale) / static_cast<float>(randomScale);
     }
 }
 
-Cloud CreateRandomCloud(float averageSize, float averageOpacity, int numberOfCircles)
+CloudSystem::CloudSystem( std::pmr::memory_resource *resource)
+    : layers( resource),
+    layerOfCloud( resource),
+    x( resource),
+    y( resource),
+    speedX( resource),
+    firstCircle( resource),
+    circleCount( resource),
+    localBounds( resource),
+    color( resource),
+    circles( resource)
 {
-    const int randomScale = 4096;
-
-    // get a random value between 0 and 1.
-    const auto getRandomValue = []{ return GetRandomValue(0, randomScale) / static_cast<float>(randomScale); };
+}
 
-    Cloud cloud;
-    cloud.color = Fade(WHITE, averageOpacity);
-    cloud.circles.reserve(numberOfCircles);
-    cloud.position = { getRandomValue(), getRandomValue() };
-    cloud.speed = { static_cast<float>( GetRandomValue( -10,10)) / 1024, 0.0f };
+CloudSystem::CloudSystem( CloudSystem &&other, std::pmr::memory_resource *resource)
+    : layers( std::move( other.layers), resource),
+    layerOfCloud( std::move( other.layerOfCloud), resource),
+    x( std::move( other.x), resource),
+    y( std::move( other.y), resource),
+    speedX( std::move( other.speedX), resource),
+    firstCircle( std::move( other.firstCircle), resource),
+    circleCount( std::move( other.circleCount), resource),
+    localBounds( std::move( other.localBounds), resource),
+    color( std::move( other.color), resource),
+    circles( std::move( other.circles), resource)
+{
+}
 
-    if (numberOfCircles > 0)
+void CloudSystem::AddLayer( WorldBounds world, const CloudLayerSettings &settings)
+{
+    const WorldBounds bounds = {
+        std::max( 1, static_cast<int>( world.width * settings.depth)),
+        std::max( 1, static_cast<int>( world.height * settings.depth))};
+    const int circlesPerCloud = std::max( settings.circlesPerCloud, 1);
+    layers.push_back( {
+        settings.depth,
+        bounds,
+        static_cast<std::uint32_t>( x.size()),
+        static_cast<std::uint32_t>( std::max( settings.clouds, 0)),
+        static_cast<std::uint32_t>( std::clamp( settings.drawnCircles, 1, circlesPerCloud))});
+
+    const float averageSize = settings.averageSize;
+    for (int cloud = 0; cloud < settings.clouds; ++cloud)
     {
-        // Start with a random initial position for the first circle
-        CloudCircle firstCircle;
-        firstCircle.position = {0.0f, 0.0f};
-        firstCircle.radius = averageSize/2 + getRandomValue() * averageSize;
-        firstCircle.opacity = getRandomValue();
-        cloud.circles.push_back(firstCircle);
-
-        for (int i = 1; i < numberOfCircles; ++i)
+        layerOfCloud.push_back( static_cast<std::uint32_t>( layers.size() - 1));
+        x.push_back( GetRandomFraction() * bounds.width);
+        y.push_back( GetRandomFraction() * bounds.height);
+
+        // Distant clouds drift slower.
+        speedX.push_back( GetRandomValue( -10, 10) * settings.depth);
+        color.push_back( Fade( WHITE, settings.opacity));
+        firstCircle.push_back( static_cast<std::uint32_t>( circles.size()));
+        circleCount.push_back( static_cast<std::uint32_t>( circlesPerCloud));
+
+        // Start with a circle at the position of the cloud, and place each
+        // next circle near one of the circles before it.
+        const auto first = circles.size();
+        circles.push_back( { { 0.0f, 0.0f}, averageSize/2 + GetRandomFraction() * averageSize, GetRandomFraction()});
+        for (int i = 1; i < circlesPerCloud; ++i)
         {
-            CloudCircle circle;
-            const auto& referenceCircle = cloud.circles[i/4];
-            float angle = getRandomValue() * 2 * M_PI;
-            float distance = 2.0f * averageSize * getRandomValue();
-            circle.position = {
-                referenceCircle.position.x + std::cos(angle) * distance,
-                referenceCircle.position.y + std::sin(angle) * distance
-            };
-            circle.radius = averageSize/2 + getRandomValue() * averageSize;
-            circle.opacity = std::min( 0.2f * getRandomValue() - 0.1f + averageOpacity, 1.0f);
-            cloud.circles.push_back(circle);
+            const auto referencePosition = circles[first + i/4].position;
+            float angle = GetRandomFraction() * 2 * M_PI;
+            float distance = 2.0f * averageSize * GetRandomFraction();
+            circles.push_back( {
+                {
+                    referencePosition.x + std::cos(angle) * distance,
+                    referencePosition.y + std::sin(angle) * distance
+                },
+                averageSize/2 + GetRandomFraction() * averageSize,
+                std::min( 0.2f * GetRandomFraction() - 0.1f + settings.opacity, 1.0f)});
         }
+
+        Vector2 topLeft = { 0.0f, 0.0f };
+        Vector2 bottomRight = topLeft;
+        for (auto circle = circles.begin() + first; circle != circles.end(); ++circle)
+        {
+            topLeft = { std::min( topLeft.x, circle->position.x - circle->radius), std::min( topLeft.y, circle->position.y - circle->radius) };
+            bottomRight = { std::max( bottomRight.x, circle->position.x + circle->radius), std::max( bottomRight.y, circle->position.y + circle->radius) };
+        }
+        localBounds.push_back( { topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y });
     }
-    return cloud;
 }
 
-CloudSystem CreateRandomCloudSystem(
-    int numberOfClouds,
-    int numberOfCircles,
-    float averageSize,
-    float averageOpacity)
+void CloudSystem::Update( float deltaTime)
 {
-    CloudSystem clouds;
-    clouds.reserve(numberOfClouds);
+    // A loop without branches per layer, which the compiler can vectorize.
+    for (const auto &layer : layers)
+    {
+        const float width = static_cast<float>( layer.bounds.width);
+        const auto end = layer.firstCloud + layer.cloudCount;
+        for (auto cloud = layer.firstCloud; cloud < end; ++cloud)
+        {
+            x[cloud] += speedX[cloud] * deltaTime;
+            x[cloud] += width * static_cast<float>( x[cloud] < 0.0f) - width * static_cast<float>( x[cloud] >= width);
+        }
+    }
+}
 
-    for (int i = 0; i < numberOfClouds; ++i)
+std::size_t CloudSystem::GetFlyingLayer() const
+{
+    for (std::size_t layer = 0; layer < layers.size(); ++layer)
     {
-        clouds.push_back(CreateRandomCloud(averageSize, averageOpacity, numberOfCircles));
+        if (layers[layer].depth == 1.0f)
+        {
+            return layer;
+        }
     }
+    return none;
+}
 
-    return clouds;
+Rectangle CloudSystem::GetBoundingBox( std::size_t cloud) const
+{
+    const auto &box = localBounds[cloud];
+    return { x[cloud] + box.x, y[cloud] + box.y, box.width, box.height };
 }
 
-void Draw( const Cloud& cloud, const GameWindow& window)
+bool CloudSystem::Contains( std::size_t cloud, Vector2 point) const
 {
-    const Vector2 scale = { static_cast<float>(window.width), static_cast<float>(window.height) };
-    const float scalarScale = std::min(scale.x, scale.y);
+    const auto &bounds = layers[layerOfCloud[cloud]].bounds;
+    const float width = static_cast<float>( bounds.width);
+    const float height = static_cast<float>( bounds.height);
+    const auto begin = circles.begin() + firstCircle[cloud];
+    for (auto circle = begin; circle != begin + circleCount[cloud]; ++circle)
+    {
+        const float dx = WrapDifference( point.x - (x[cloud] + circle->position.x), width);
+        const float dy = WrapDifference( point.y - (y[cloud] + circle->position.y), height);
+        if (dx * dx + dy * dy < circle->radius * circle->radius)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Draw the cloud's circles
-    for (const auto& circle : cloud.circles)
+void CloudSystem::DrawLayer( std::size_t layerIndex, WrapRenderer &renderer) const
+{
+    const auto &layer = layers[layerIndex];
+    const auto &viewport = renderer.GetViewport();
+    const auto end = layer.firstCloud + layer.cloudCount;
+    for (auto cloud = layer.firstCloud; cloud < end; ++cloud)
     {
-        const auto pixelPosition = Scale(scale, circle.position + cloud.position);
-        const auto pixelRadius = scalarScale * circle.radius;
-        DrawCircleV(
-            pixelPosition,
-            pixelRadius,
-            Fade(cloud.color, circle.opacity));
-
-        if (pixelPosition.x + pixelRadius > window.width)
+        // Skip whole clouds that are out of view, before looking at their circles.
+        if (not viewport.IsVisible( GetBoundingBox( cloud)))
         {
-            DrawCircleV(
-                pixelPosition - Vector2{ static_cast<float>( window.width), 0.0f},
-                pixelRadius,
-                Fade(cloud.color, circle.opacity));
+            continue;
         }
-        else if ( pixelPosition.x < pixelRadius)
+
+        const Vector2 position = { x[cloud], y[cloud] };
+        const auto begin = circles.begin() + firstCircle[cloud];
+        const auto drawn = std::min( layer.drawnCircles, circleCount[cloud]);
+        for (auto circle = begin; circle != begin + drawn; ++circle)
         {
-            DrawCircleV(
-                pixelPosition + Vector2{ static_cast<float>( window.width), 0.0f},
-                pixelRadius,
-                Fade(cloud.color, circle.opacity));
+            renderer.AddCircle(
+                position + circle->position,
+                circle->radius,
+                Fade(color[cloud], circle->opacity));
         }
     }
+}
+
+void CloudSystem::Save( SnapshotWriter &writer) const
+{
+    writer.WriteArray( std::span<const float>( x));
+}
 
-    //DrawCircleV( Scale( scale, cloud.position), 5, RED);
+bool CloudSystem::Load( SnapshotReader &reader)
+{
+    std::vector<float> positions;
+    if (not reader.ReadArray( positions) or positions.size() != x.size())
+    {
+        return false;
+    }
+    std::copy( positions.begin(), positions.end(), x.begin());
+    return true;
 }
 
-void Update( Cloud& cloud, const GameWindow& window, float deltaTime)
+CloudSystem CreateRandomSky( WorldBounds world, const CloudLayerSettings &flyingLayer)
 {
-    cloud.position.x += cloud.speed.x * deltaTime;
-    cloud.position.y += cloud.speed.y * deltaTime;
-    cloud.position = {
-        Wrap(cloud.position.x, 1.0f),
-        Wrap(cloud.position.y, 1.0f)};
+    // Clouds per pixel of the layer, relative to the flying layer. A layer
+    // with depth d is d * d times the area of the world.
+    const auto GetCloudCount = [&]( float depth, float relativeDensity) {
+        return std::max( 1, static_cast<int>( std::lround( relativeDensity * depth * depth * flyingLayer.clouds)));
+    };
+    const auto Scale = [&]( int circles, float fraction) {
+        return std::max( 1, static_cast<int>( circles * fraction));
+    };
+
+    CloudSystem sky;
+    sky.AddLayer( world, {
+        0.4f,
+        GetCloudCount( 0.4f, 6.0f),
+        Scale( flyingLayer.circlesPerCloud, 0.5f),
+        Scale( flyingLayer.circlesPerCloud, 0.2f),
+        flyingLayer.averageSize * 0.4f,
+        flyingLayer.opacity * 0.4f});
+    sky.AddLayer( world, {
+        0.7f,
+        GetCloudCount( 0.7f, 3.0f),
+        Scale( flyingLayer.circlesPerCloud, 0.75f),
+        Scale( flyingLayer.circlesPerCloud, 0.4f),
+        flyingLayer.averageSize * 0.7f,
+        flyingLayer.opacity * 0.6f});
+    sky.AddLayer( world, flyingLayer);
+    return sky;
 }
@@ -2,34 +2,135 @@
 #define CLOUD_SYSTEM_H
 
 #include "raylib.h"
+#include "Snapshot.h"
+#include "WorldBounds.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
 
-struct GameWindow;
+class WrapRenderer;
 
 struct CloudCircle
 {
-    Vector2 position;
+    Vector2 position;   ///< relative to the position of the cloud
     float radius;
     float opacity;
 };
 
-struct Cloud
+/// How to create a layer of random clouds.
+struct CloudLayerSettings
 {
-    Vector2 position;
-    Vector2 speed;
-    std::vector<CloudCircle> circles;
-    Color color;
+    float depth = 1.0f;         ///< 1 for the layer that the planes fly in, less for layers further away
+    int clouds = 4;
+    int circlesPerCloud = 24;
+    int drawnCircles = 24;      ///< circles to draw per cloud, fewer for distant layers
+    float averageSize = 37.5f;  ///< average radius of the circles, in pixels
+    float opacity = 0.9f;
 };
 
-using CloudSystem = std::vector<Cloud>;
-void Draw(const Cloud& cloud, const GameWindow& window);
-void Update(Cloud& cloud, const GameWindow& window, float deltaTime);
+/**
+ * The clouds in the sky, in layers at different depths.
+ *
+ * The planes fly in the layer with depth 1, which has the size of the world
+ * and whose clouds act as sensors: planes know when they are in one of them.
+ * Layers further away are only scenery. A layer with depth d is a world of
+ * its own, d times the size of the world in whole pixels, that the camera
+ * looks at from the point that is as far across the layer as the camera is
+ * across the world. It moves about d times as fast across the screen, which
+ * gives parallax, and it wraps around seamlessly whenever the world does.
+ *
+ * All clouds of all layers are stored together, each attribute in an array of
+ * its own, so that moving them is a straight loop per layer. The circles of
+ * all clouds are stored in a single array as well, where each cloud has a
+ * span of consecutive circles. A circle is placed near one of the circles
+ * before it, so the first circles of a cloud always form a smaller version of
+ * it. Distant layers draw only those first circles.
+ */
+class CloudSystem
+{
+public:
+    static constexpr std::size_t none = ~std::size_t{ 0};
+
+    struct Layer
+    {
+        float           depth;
+        WorldBounds     bounds;         ///< the size of the layer, in pixels
+        std::uint32_t   firstCloud;
+        std::uint32_t   cloudCount;
+        std::uint32_t   drawnCircles;
+    };
+
+    CloudSystem() = default;
+    explicit CloudSystem( std::pmr::memory_resource *resource);
+
+    /// Move the clouds into memory of the given resource, for instance into the arena of a match.
+    CloudSystem( CloudSystem &&other, std::pmr::memory_resource *resource);
+
+    /**
+     * Add a layer of random clouds to a world of the given size. Layers are
+     * drawn in the order in which they are added.
+     */
+    void AddLayer( WorldBounds world, const CloudLayerSettings &settings);
+
+    /// Drift all clouds along, each layer wrapping around at its own size.
+    void Update( float deltaTime);
+
+    std::size_t GetLayerCount() const { return layers.size(); }
+    const Layer &GetLayer( std::size_t layer) const { return layers[layer]; }
+
+    /// The index of the layer that the planes fly in, or none.
+    std::size_t GetFlyingLayer() const;
+
+    std::size_t GetCloudCount() const { return x.size(); }
+    std::size_t GetCircleCount() const { return circles.size(); }
+
+    /**
+     * The box around all circles of the cloud in the coordinates of its layer.
+     * The box is not wrapped, so it may extend beyond the edges of the layer.
+     */
+    Rectangle GetBoundingBox( std::size_t cloud) const;
+
+    /// Is the point, in the coordinates of the layer of the cloud, inside any of its circles?
+    bool Contains( std::size_t cloud, Vector2 point) const;
+
+    /**
+     * Add the visible circles of the clouds of a layer to the renderer, whose
+     * viewport must look at the layer.
+     */
+    void DrawLayer( std::size_t layer, WrapRenderer &renderer) const;
+
+    /**
+     * Write where the clouds have drifted to. Everything else about the
+     * clouds comes from the random seed that created them.
+     */
+    void Save( SnapshotWriter &writer) const;
+
+    /// Read what Save() wrote for the same sky, failing if the number of clouds differs.
+    bool Load( SnapshotReader &reader);
+
+private:
+    std::pmr::vector<Layer>         layers;
+    std::pmr::vector<std::uint32_t> layerOfCloud;
+
+    // The clouds, one entry per cloud in each array.
+    std::pmr::vector<float>         x;
+    std::pmr::vector<float>         y;
+    std::pmr::vector<float>         speedX;
+    std::pmr::vector<std::uint32_t> firstCircle;
+    std::pmr::vector<std::uint32_t> circleCount;
+    std::pmr::vector<Rectangle>     localBounds;    ///< the box around the circles, relative to the cloud position
+    std::pmr::vector<Color>         color;
+
+    std::pmr::vector<CloudCircle>   circles;
+};
+
+/**
+ * Create a sky for a world of the given size: two distant layers that are
+ * more crowded than the given layer that the planes fly in, with smaller and
+ * fainter clouds that are drawn with fewer circles.
+ */
+CloudSystem CreateRandomSky( WorldBounds world, const CloudLayerSettings &flyingLayer);
 
-Cloud CreateRandomCloud(float averageSize, float averageOpacity, int numberOfCircles);
-CloudSystem CreateRandomCloudSystem(
-    int numberOfClouds,
-    int numberOfCircles,
-    float averageSize,
-    float averageOpacity);
 #endif // CLOUD_SYSTEM_H
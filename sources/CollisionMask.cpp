@@ -0,0 +1,91 @@
+#include "CollisionMask.h"
+
+#include <algorithm>
+#include <cmath>
+
+CollisionMask::CollisionMask( const Image &image, unsigned char alphaThreshold)
+{
+    if (image.data == nullptr or image.width > maxWidth)
+    {
+        return;
+    }
+
+    width = image.width;
+    rows.resize( image.height, Row{});
+    for (int y = 0; y < image.height; ++y)
+    {
+        for (int x = 0; x < image.width; ++x)
+        {
+            if (GetImageColor( image, x, y).a >= alphaThreshold)
+            {
+                rows[y][x / wordBits] |= std::uint64_t{ 1} << (x % wordBits);
+            }
+        }
+    }
+}
+
+bool CollisionMask::Test( int x, int y) const
+{
+    return TestRun( y, x, x);
+}
+
+bool CollisionMask::TestRun( int y, int x0, int x1) const
+{
+    if (y < 0 or y >= GetHeight())
+    {
+        return false;
+    }
+    x0 = std::max( x0, 0);
+    x1 = std::min( x1, width - 1);
+
+    const auto &row = rows[y];
+    std::uint64_t hits = 0;
+    for (int word = x0 / wordBits; word <= x1 / wordBits and x0 <= x1; ++word)
+    {
+        // Select the bits [low, high] of this word.
+        const int low = std::max( x0 - word * wordBits, 0);
+        const int high = std::min( x1 - word * wordBits, wordBits - 1);
+        const auto selection = (~std::uint64_t{ 0} >> (wordBits - 1 - (high - low))) << low;
+        hits |= row[word] & selection;
+    }
+    return hits != 0;
+}
+
+bool CollisionMask::TestSegment( Vector2 start, Vector2 end) const
+{
+    if (IsEmpty())
+    {
+        return false;
+    }
+
+    if (start.y > end.y)
+    {
+        std::swap( start, end);
+    }
+
+    const int firstRow = std::max( static_cast<int>( std::floor( start.y)), 0);
+    const int lastRow = std::min( static_cast<int>( std::floor( end.y)), GetHeight() - 1);
+    const float deltaY = end.y - start.y;
+    const float slope = deltaY > 0.0f ? (end.x - start.x) / deltaY : 0.0f;
+
+    for (int y = firstRow; y <= lastRow; ++y)
+    {
+        // The part of the segment that lies within this row.
+        float xBegin = start.x;
+        float xEnd = end.x;
+        if (deltaY > 0.0f)
+        {
+            xBegin = start.x + slope * (std::max( static_cast<float>( y), start.y) - start.y);
+            xEnd = start.x + slope * (std::min( static_cast<float>( y + 1), end.y) - start.y);
+        }
+
+        if (TestRun(
+                y,
+                static_cast<int>( std::floor( std::min( xBegin, xEnd))),
+                static_cast<int>( std::floor( std::max( xBegin, xEnd)))))
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,59 @@
+#ifndef COLLISION_MASK_H
+#define COLLISION_MASK_H
+
+#include "raylib.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A one bit per pixel mask of the opaque pixels of a sprite, for pixel
+ * accurate collision tests.
+ *
+ * Every row is stored as a fixed number of 64 bit words, so that testing a
+ * horizontal run of pixels takes a shift, a mask and an 'or' per word instead
+ * of a test per pixel.
+ */
+class CollisionMask
+{
+public:
+    static constexpr int maxWidth = 128;
+
+    CollisionMask() = default;
+
+    /**
+     * Create a mask from the alpha channel of an image. Pixels with an alpha
+     * of at least alphaThreshold are solid. Images that are wider than
+     * maxWidth, or that have no data, result in an empty mask.
+     */
+    explicit CollisionMask( const Image &image, unsigned char alphaThreshold = 128);
+
+    bool IsEmpty() const { return rows.empty(); }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return static_cast<int>( rows.size()); }
+
+    /// Is pixel (x, y) solid? Pixels outside the mask are not.
+    bool Test( int x, int y) const;
+
+    /// Is any pixel from x0 up to and including x1 in row y solid?
+    bool TestRun( int y, int x0, int x1) const;
+
+    /**
+     * Does the line segment from start to end, in pixel coordinates of the
+     * mask, touch any solid pixel?
+     *
+     * The segment is walked row by row and the pixels that the segment
+     * covers in each row are tested as a single run.
+     */
+    bool TestSegment( Vector2 start, Vector2 end) const;
+
+private:
+    static constexpr int wordBits = 64;
+    using Row = std::array<std::uint64_t, maxWidth / wordBits>;
+
+    int                 width = 0;
+    std::vector<Row>    rows;
+};
+
+#endif // COLLISION_MASK_H
@@ -0,0 +1,220 @@
+#include "CollisionPipeline.h"
+
+#include "DrawingUtilities.h"
+#include "Float4.h"
+
+#include <cmath>
+#include <utility>
+
+void CollisionPipeline::SetInteraction( CollisionLayer first, CollisionLayer second, bool interacts)
+{
+    const auto firstBit = std::uint8_t( 1u << Index( first));
+    const auto secondBit = std::uint8_t( 1u << Index( second));
+    if (interacts)
+    {
+        layerMatrix[Index( first)] |= secondBit;
+        layerMatrix[Index( second)] |= firstBit;
+    }
+    else
+    {
+        layerMatrix[Index( first)] &= ~secondBit;
+        layerMatrix[Index( second)] &= ~firstBit;
+    }
+}
+
+void CollisionPipeline::Begin( const WorldBounds &world)
+{
+    this->world = world;
+
+    // Make the world an exact number of cells wide and high, so that cells
+    // wrap around together with the world.
+    gridWidth = std::max( 1, static_cast<int>( world.width / targetCellSize));
+    gridHeight = std::max( 1, static_cast<int>( world.height / targetCellSize));
+    cellSize = {
+        static_cast<float>( world.width) / gridWidth,
+        static_cast<float>( world.height) / gridHeight};
+
+    proxies.clear();
+    cellStarts.clear();
+}
+
+void CollisionPipeline::AddProxy( CollisionLayer layer, std::uint32_t index, const Rectangle &box)
+{
+    if (layerMatrix[Index( layer)] == 0)
+    {
+        return;
+    }
+
+    const int firstX = static_cast<int>( std::floor( box.x / cellSize.x));
+    const int firstY = static_cast<int>( std::floor( box.y / cellSize.y));
+    const int lastX = static_cast<int>( std::floor( (box.x + box.width) / cellSize.x));
+    const int lastY = static_cast<int>( std::floor( (box.y + box.height) / cellSize.y));
+
+    proxies.push_back( {
+        box,
+        index,
+        layer,
+        firstX,
+        firstY,
+        std::min( lastX - firstX + 1, gridWidth),
+        std::min( lastY - firstY + 1, gridHeight)});
+}
+
+Contact CollisionPipeline::MakeContact( const Proxy &proxy1, const Proxy &proxy2)
+{
+    if (std::tie( proxy2.layer, proxy2.index) < std::tie( proxy1.layer, proxy1.index))
+    {
+        return { proxy2.layer, proxy1.layer, proxy2.index, proxy1.index};
+    }
+    return { proxy1.layer, proxy2.layer, proxy1.index, proxy2.index};
+}
+
+bool CollisionPipeline::BoxesOverlap( const Rectangle &box1, const Rectangle &box2) const
+{
+#if defined( PLANES_SIMD)
+    // The same as below, with x in the first lane and y in the second.
+    const auto first = std::bit_cast<Float4>( box1);
+    const auto second = std::bit_cast<Float4>( box2);
+    const auto size1 = SpreadHigh( first);
+    const auto size2 = SpreadHigh( second);
+    const auto width = static_cast<float>( world.width);
+    const auto height = static_cast<float>( world.height);
+    const Float4 worldSize = { width, height, width, height};
+    const Float4 half = worldSize / 2;
+    const Float4 difference = Wrap( (second + size2 / 2) - (first + size1 / 2) + half, worldSize) - half;
+    const Mask4 overlaps = Abs( difference) <= (size1 + size2) / 2;
+    return overlaps[0] and overlaps[1];
+#else
+    const float dx = WrapDifference(
+        (box2.x + box2.width / 2) - (box1.x + box1.width / 2),
+        static_cast<float>( world.width));
+    const float dy = WrapDifference(
+        (box2.y + box2.height / 2) - (box1.y + box1.height / 2),
+        static_cast<float>( world.height));
+    return std::abs( dx) <= (box1.width + box2.width) / 2
+        and std::abs( dy) <= (box1.height + box2.height) / 2;
+#endif
+}
+
+void CollisionPipeline::FillGrid()
+{
+    // Counting sort of the proxies into groups per cell and layer.
+    const auto groupCount = static_cast<std::size_t>( gridWidth * gridHeight) * layerCount;
+    cellStarts.assign( groupCount + 1, 0);
+    for (const auto &proxy : proxies)
+    {
+        ForEachCell( proxy, [this, &proxy]( int cell) { ++cellStarts[GetGroup( cell, proxy.layer) + 1]; });
+    }
+    for (std::size_t group = 0; group < groupCount; ++group)
+    {
+        cellStarts[group + 1] += cellStarts[group];
+    }
+
+    // Use the start of each group as a write cursor. Afterwards, every cursor
+    // points to the start of the next group, so shift them back by one.
+    cellEntries.resize( cellStarts[groupCount]);
+    for (std::uint32_t proxyIndex = 0; proxyIndex < proxies.size(); ++proxyIndex)
+    {
+        const auto &proxy = proxies[proxyIndex];
+        ForEachCell( proxy, [this, &proxy, proxyIndex]( int cell)
+        {
+            cellEntries[cellStarts[GetGroup( cell, proxy.layer)]++] = proxyIndex;
+        });
+    }
+    for (std::size_t group = groupCount; group > 0; --group)
+    {
+        cellStarts[group] = cellStarts[group - 1];
+    }
+    cellStarts[0] = 0;
+}
+
+int CollisionPipeline::FirstSharedCell( const Proxy &proxy1, const Proxy &proxy2) const
+{
+    // The first cell of the overlap of both ranges of cells, along one axis.
+    // The range of the second proxy is first moved by whole worlds to where
+    // its box overlaps with the box of the first proxy.
+    const auto firstShared = [](
+        float center1, float center2, float worldSize,
+        int first1, int count1, int first2, int count2, int gridSize)
+    {
+        if (count2 == gridSize)
+        {
+            return first1;
+        }
+        if (count1 == gridSize)
+        {
+            return first2;
+        }
+        const float difference = center2 - center1;
+        const int worlds = static_cast<int>( std::round( (WrapDifference( difference, worldSize) - difference) / worldSize));
+        return std::max( first1, first2 + worlds * gridSize);
+    };
+
+    const auto &box1 = proxy1.box;
+    const auto &box2 = proxy2.box;
+    const int x = firstShared(
+        box1.x + box1.width / 2, box2.x + box2.width / 2, static_cast<float>( world.width),
+        proxy1.cellX, proxy1.cellsX, proxy2.cellX, proxy2.cellsX, gridWidth);
+    const int y = firstShared(
+        box1.y + box1.height / 2, box2.y + box2.height / 2, static_cast<float>( world.height),
+        proxy1.cellY, proxy1.cellsY, proxy2.cellY, proxy2.cellsY, gridHeight);
+    return WrapCell( x, y);
+}
+
+void CollisionPipeline::FindCandidates()
+{
+    // In play there are rarely more candidates than proxies. Reserving that
+    // many up front keeps the buffer from growing bit by bit whenever a tick
+    // sets a new record.
+    candidates.clear();
+    candidates.reserve( proxies.capacity());
+
+    const auto cellCount = (cellStarts.size() - 1) / layerCount;
+    for (std::size_t cell = 0; cell < cellCount; ++cell)
+    {
+        for (std::size_t layer1 = 0; layer1 < layerCount; ++layer1)
+        {
+            for (std::size_t layer2 = layer1; layer2 < layerCount; ++layer2)
+            {
+                if ((layerMatrix[layer1] >> layer2) & 1)
+                {
+                    PairGroups( static_cast<int>( cell), cell * layerCount + layer1, cell * layerCount + layer2);
+                }
+            }
+        }
+    }
+}
+
+void CollisionPipeline::PairGroups( int cell, std::size_t group1, std::size_t group2)
+{
+    const auto end1 = cellStarts[group1 + 1];
+    const auto end2 = cellStarts[group2 + 1];
+    for (auto entry1 = cellStarts[group1]; entry1 < end1; ++entry1)
+    {
+        const auto proxyIndex1 = cellEntries[entry1];
+        const auto &proxy1 = proxies[proxyIndex1];
+        const bool single1 = proxy1.cellsX == 1 and proxy1.cellsY == 1;
+
+        // Within a single group, each pair only once.
+        for (auto entry2 = group1 == group2 ? entry1 + 1 : cellStarts[group2]; entry2 < end2; ++entry2)
+        {
+            const auto proxyIndex2 = cellEntries[entry2];
+            const auto &proxy2 = proxies[proxyIndex2];
+            if (not BoxesOverlap( proxy1.box, proxy2.box))
+            {
+                continue;
+            }
+
+            // Two proxies that each cover a single cell can only meet in
+            // that cell. Other pairs may meet in several cells and are
+            // only reported in the first cell that they share.
+            const bool single = single1 and proxy2.cellsX == 1 and proxy2.cellsY == 1;
+            if (single or FirstSharedCell( proxy1, proxy2) == cell)
+            {
+                candidates.push_back(
+                    (std::uint64_t{ std::min( proxyIndex1, proxyIndex2)} << 32)
+                    | std::max( proxyIndex1, proxyIndex2));
+            }
+        }
+    }
+}
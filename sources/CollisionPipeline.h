@@ -0,0 +1,220 @@
+#ifndef COLLISION_PIPELINE_H
+#define COLLISION_PIPELINE_H
+
+#include "raylib.h"
+#include "WorldBounds.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <tuple>
+#include <vector>
+
+/**
+ * The kinds of objects that take part in collision detection.
+ */
+enum class CollisionLayer : std::uint8_t
+{
+    Planes,
+    Bullets,
+    Clouds,
+    Count
+};
+
+/**
+ * A contact between two objects, as found by the collision pipeline.
+ *
+ * The object with the lowest layer comes first, objects in the same layer are
+ * ordered by index.
+ */
+struct Contact
+{
+    CollisionLayer  firstLayer;
+    CollisionLayer  secondLayer;
+    std::uint32_t   first;  ///< index of the first object within its layer
+    std::uint32_t   second; ///< index of the second object within its layer
+};
+
+/**
+ * Finds contacts between objects in any combination of collision layers in a
+ * single broadphase pass.
+ *
+ * Every tick, the owner adds a proxy for each object: its layer, its index
+ * within the layer and a box that contains everything the object touched
+ * during the tick. The proxies are sorted into a uniform grid that wraps
+ * around with the world, and within each cell by layer. Only pairs of
+ * proxies that share a grid cell, whose layers interact according to the
+ * layer matrix and whose boxes overlap are passed to the narrowphase, and the
+ * pairs that the narrowphase accepts are collected as contacts in a flat
+ * buffer. Pairs of layers that do not interact are never looked at, and
+ * proxies of layers that interact with nothing are not even added.
+ *
+ * All buffers keep their capacity between ticks, so in a steady state finding
+ * contacts does not allocate.
+ */
+class CollisionPipeline
+{
+public:
+    using Contacts = std::pmr::vector<Contact>;
+
+    /// Approximate size of a grid cell in pixels.
+    static constexpr float targetCellSize = 32.0f;
+
+    explicit CollisionPipeline( std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : proxies( resource), cellStarts( resource), cellEntries( resource), candidates( resource), contacts( resource)
+    {
+    }
+
+    void SetInteraction( CollisionLayer first, CollisionLayer second, bool interacts);
+    bool Interacts( CollisionLayer first, CollisionLayer second) const
+    {
+        return (layerMatrix[Index( first)] >> Index( second)) & 1;
+    }
+
+    /// Remove all proxies and adapt the grid to the world.
+    void Begin( const WorldBounds &world);
+
+    /// Add an object, unless its layer interacts with no layer at all.
+    void AddProxy( CollisionLayer layer, std::uint32_t index, const Rectangle &box);
+
+    /**
+     * Find all contacts between the proxies that were added since Begin().
+     *
+     * The narrowphase is called as narrowphase( contact) for every candidate
+     * and must return whether the two objects really touch. Each pair of
+     * objects is offered to the narrowphase at most once. The resulting
+     * contacts are sorted by layers and indices.
+     */
+    template< typename Narrowphase>
+    const Contacts &FindContacts( Narrowphase &&narrowphase)
+    {
+        FillGrid();
+        FindCandidates();
+
+        contacts.clear();
+        contacts.reserve( candidates.capacity());
+        for (const auto candidate : candidates)
+        {
+            const auto &proxy1 = proxies[candidate >> 32];
+            const auto &proxy2 = proxies[candidate & 0xffffffff];
+            const auto contact = MakeContact( proxy1, proxy2);
+            if (narrowphase( contact))
+            {
+                contacts.push_back( contact);
+            }
+        }
+        std::sort( contacts.begin(), contacts.end(), [](const Contact &lhs, const Contact &rhs)
+        {
+            return std::tie( lhs.firstLayer, lhs.secondLayer, lhs.first, lhs.second)
+                < std::tie( rhs.firstLayer, rhs.secondLayer, rhs.first, rhs.second);
+        });
+        return contacts;
+    }
+
+    const Contacts &GetContacts() const { return contacts; }
+
+    /**
+     * Call visit( index) for the objects in the given layer whose boxes may
+     * overlap 'box', as of the last call to FindContacts(). Layers that
+     * interact with no layer are never found.
+     *
+     * This uses the grid without checking the boxes themselves, so objects
+     * in nearby cells are visited too. An object that covers several cells
+     * may be visited more than once.
+     */
+    template< typename Visit>
+    void Query( CollisionLayer layer, const Rectangle &box, Visit &&visit) const
+    {
+        if (cellStarts.empty())
+        {
+            return;
+        }
+
+        const int firstX = static_cast<int>( std::floor( box.x / cellSize.x));
+        const int firstY = static_cast<int>( std::floor( box.y / cellSize.y));
+        const int cellsX = std::min( static_cast<int>( std::floor( (box.x + box.width) / cellSize.x)) - firstX + 1, gridWidth);
+        const int cellsY = std::min( static_cast<int>( std::floor( (box.y + box.height) / cellSize.y)) - firstY + 1, gridHeight);
+        for (int y = 0; y < cellsY; ++y)
+        {
+            for (int x = 0; x < cellsX; ++x)
+            {
+                const auto group = GetGroup( WrapCell( firstX + x, firstY + y), layer);
+                for (auto entry = cellStarts[group]; entry < cellStarts[group + 1]; ++entry)
+                {
+                    visit( proxies[cellEntries[entry]].index);
+                }
+            }
+        }
+    }
+
+private:
+    struct Proxy
+    {
+        Rectangle       box;
+        std::uint32_t   index;
+        CollisionLayer  layer;
+        // range of cells covered, in unwrapped cell coordinates.
+        int             cellX;
+        int             cellY;
+        int             cellsX;
+        int             cellsY;
+    };
+
+    static constexpr std::size_t layerCount = static_cast<std::size_t>( CollisionLayer::Count);
+    static std::size_t Index( CollisionLayer layer) { return static_cast<std::size_t>( layer); }
+
+    static Contact MakeContact( const Proxy &proxy1, const Proxy &proxy2);
+    bool BoxesOverlap( const Rectangle &box1, const Rectangle &box2) const;
+
+    /// The index of the cell at unwrapped cell coordinates (x, y).
+    int WrapCell( int x, int y) const
+    {
+        return ((y % gridHeight + gridHeight) % gridHeight) * gridWidth
+            + (x % gridWidth + gridWidth) % gridWidth;
+    }
+
+    /// The entries of the proxies of a layer in a cell are cellEntries[cellStarts[group]] up to those of the next group.
+    static std::size_t GetGroup( int cell, CollisionLayer layer)
+    {
+        return static_cast<std::size_t>( cell) * layerCount + Index( layer);
+    }
+
+    /// The one cell in which a pair of overlapping proxies is reported.
+    int FirstSharedCell( const Proxy &proxy1, const Proxy &proxy2) const;
+
+    template< typename Visit>
+    void ForEachCell( const Proxy &proxy, Visit &&visit) const
+    {
+        for (int y = 0; y < proxy.cellsY; ++y)
+        {
+            for (int x = 0; x < proxy.cellsX; ++x)
+            {
+                visit( WrapCell( proxy.cellX + x, proxy.cellY + y));
+            }
+        }
+    }
+
+    void FillGrid();
+    void FindCandidates();
+
+    /// Add the overlapping pairs of proxies from two groups of the same cell to the candidates.
+    void PairGroups( int cell, std::size_t group1, std::size_t group2);
+
+    std::array<std::uint8_t, layerCount> layerMatrix = {};
+
+    WorldBounds                 world = { 0, 0};
+    int                         gridWidth = 1;
+    int                         gridHeight = 1;
+    Vector2                     cellSize = { 1.0f, 1.0f};
+
+    std::pmr::vector<Proxy>         proxies;
+    std::pmr::vector<std::uint32_t> cellStarts;     ///< per cell and layer, the offset of its first entry in cellEntries
+    std::pmr::vector<std::uint32_t> cellEntries;    ///< proxy indices, grouped per cell and within that per layer
+    std::pmr::vector<std::uint64_t> candidates;     ///< pairs of proxy indices, packed in 64 bits
+    Contacts                    contacts;
+};
+
+#endif // COLLISION_PIPELINE_H
@@ -0,0 +1,103 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include "Bullet.h"
+#include "Plane.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+/**
+ * Changes to the simulation that are recorded while a stage of a tick runs,
+ * and that are applied together once the stage is done.
+ *
+ * While a stage runs, planes and bullets stay where they are: no container
+ * grows or shrinks and indices remain valid, so the stage does not need to
+ * keep track of its own changes and different parts of a stage could even run
+ * in parallel, each with its own buffer.
+ *
+ * Commands are applied in a fixed order: plane state changes, score
+ * increments, bullet despawns and finally bullet spawns. Despawns refer to
+ * bullets by their index at the time of recording, which is why a buffer must
+ * be applied before anything else changes the bullets.
+ *
+ * The buffer keeps its capacity when it is cleared, so recording commands does
+ * not allocate once a game has been running for a while.
+ */
+class CommandBuffer
+{
+public:
+    struct PlaneStateChange
+    {
+        std::uint32_t   plane;
+        Plane::State    from;   ///< the change is skipped if the plane is no longer in this state
+        Plane::State    to;
+    };
+
+    struct ScoreIncrement
+    {
+        std::uint32_t   plane;
+        int             points;
+    };
+
+    explicit CommandBuffer( std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : bulletSpawns( resource), bulletDespawns( resource), planeStateChanges( resource), scoreIncrements( resource)
+    {
+    }
+
+    /// Record a new bullet, constructed from the given arguments when the buffer is applied.
+    template< typename... Arguments>
+    void SpawnBullet( Arguments&&... arguments)
+    {
+        bulletSpawns.emplace_back( std::forward<Arguments>( arguments)...);
+    }
+
+    /// Record the removal of a bullet. Recording the same bullet more than once is harmless.
+    void DespawnBullet( std::uint32_t index) { bulletDespawns.push_back( index); }
+
+    void ChangePlaneState( std::uint32_t plane, Plane::State from, Plane::State to)
+    {
+        planeStateChanges.push_back( { plane, from, to});
+    }
+
+    void AddScore( std::uint32_t plane, int points = 1) { scoreIncrements.push_back( { plane, points}); }
+
+    /// Make room for the commands of a tick in a world with the given number of planes and bullets.
+    void Reserve( std::size_t planes, std::size_t bullets)
+    {
+        bulletSpawns.reserve( planes);
+        bulletDespawns.reserve( bullets);
+        planeStateChanges.reserve( planes);
+        scoreIncrements.reserve( planes);
+    }
+
+    bool IsEmpty() const
+    {
+        return bulletSpawns.empty() and bulletDespawns.empty()
+            and planeStateChanges.empty() and scoreIncrements.empty();
+    }
+
+    void Clear()
+    {
+        bulletSpawns.clear();
+        bulletDespawns.clear();
+        planeStateChanges.clear();
+        scoreIncrements.clear();
+    }
+
+    const Bullets &GetBulletSpawns() const { return bulletSpawns; }
+    const std::pmr::vector<std::uint32_t> &GetBulletDespawns() const { return bulletDespawns; }
+    const std::pmr::vector<PlaneStateChange> &GetPlaneStateChanges() const { return planeStateChanges; }
+    const std::pmr::vector<ScoreIncrement> &GetScoreIncrements() const { return scoreIncrements; }
+
+private:
+    Bullets                             bulletSpawns;
+    std::pmr::vector<std::uint32_t>     bulletDespawns;
+    std::pmr::vector<PlaneStateChange>  planeStateChanges;
+    std::pmr::vector<ScoreIncrement>    scoreIncrements;
+};
+
+#endif // COMMAND_BUFFER_H
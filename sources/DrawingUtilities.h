@@ -2,7 +2,6 @@
 #define DRAWING_UTILITIES_H
 
 #include "Angle256.h"
-#include "GameWindow.h"
 #include "raylib.h"
 
 
@@ -21,47 +20,14 @@ ValueType Wrap(ValueType value, ValueType max)
 }
 
 /**
- * Draw the given texture to the screen, wrapping it around the screen edges if necessary.
- * Wrapping is done by drawing the texture at its original position and at the
- * wrapped positions on the x and y axes.
+ * Map the difference between two coordinates on a wrapping axis of the given
+ * size to the shortest equivalent difference, in the range [-max/2, max/2).
  */
-inline void DrawWrapped(
-    const GameWindow &window,
-    const Texture2D& texture,
-    const Vector2& position,
-    const Vector2& offset,
-    Angle256 angle,
-    const Color& tint,
-    bool offBottom = false)
+template <typename ValueType>
+ValueType WrapDifference(ValueType difference, ValueType max)
 {
-    Vector2 textureSize = { static_cast<float>(texture.width), static_cast<float>(texture.height) };
-    Rectangle sourceRect = { 0.0f, 0.0f, textureSize.x, textureSize.y };
-    const Rectangle destRect = { position.x, position.y, textureSize.x, textureSize.y };
-    float rotation = (angle / 256.0f) * 360.0f;
-
-    // Draw the main texture
-    DrawTexturePro(texture, sourceRect, destRect, offset, rotation, tint);
-
-    // Handle wrapping on the x-axis
-    if (position.x < textureSize.x/2) // TODO: offset.x
-    {
-        DrawTexturePro(texture, sourceRect, {destRect.x + window.width, destRect.y, destRect.width, destRect.height}, offset, rotation, tint);
-    }
-    else if (position.x >= window.width - textureSize.x/2)
-    {
-        DrawTexturePro(texture, sourceRect, {destRect.x - window.width, destRect.y, destRect.width, destRect.height}, offset, rotation, tint);
-    }
-
-    // Handle wrapping on the y-axis
-    if (position.y < textureSize.y/2)
-    {
-        DrawTexturePro(texture, sourceRect, {destRect.x, destRect.y + window.height, destRect.width, destRect.height}, offset, rotation, tint);
-    }
-    else if (not offBottom and position.y >= window.height - textureSize.y/2)
-    {
-        DrawTexturePro(texture, sourceRect, {destRect.x, destRect.y - window.height, destRect.width, destRect.height}, offset, rotation, tint);
-    }
-
+    const ValueType half = max / 2;
+    return Wrap(difference + half, max) - half;
 }
 
 #endif // DRAWING_UTILITIES_H
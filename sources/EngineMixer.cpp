@@ -0,0 +1,219 @@
+#include "EngineMixer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace { // unnamed
+
+    /// The mixer that the audio callback fills the stream with.
+    std::atomic<EngineMixer*> activeMixer{ nullptr};
+
+    /// raylib's pan law: a pan of 1 is all left, 0.5 is the center.
+    float GetPanLevel( float pan)
+    {
+        return 0.5f * pan * (3.0f - pan * pan);
+    }
+
+    float Interpolate( float from, float to, float fraction)
+    {
+        return from + (to - from) * fraction;
+    }
+
+    /**
+     * Leave quiet samples alone and bend loud ones smoothly towards full
+     * scale, so that many engines at once do not clip harshly.
+     */
+    float Limit( float sample)
+    {
+        constexpr float knee = 0.5f;
+        const float magnitude = std::abs( sample);
+        if (magnitude <= knee)
+        {
+            return sample;
+        }
+        return std::copysign( knee + (1.0f - knee) * std::tanh( (magnitude - knee) / (1.0f - knee)), sample);
+    }
+}
+
+EngineMixer::EngineMixer( const char *engineLoopPath)
+{
+    Wave wave = LoadWave( engineLoopPath);
+    if (wave.frameCount > 0)
+    {
+        WaveFormat( &wave, sampleRate, 32, 1);
+        if (float *samples = LoadWaveSamples( wave))
+        {
+            loop.assign( samples, samples + wave.frameCount);
+            UnloadWaveSamples( samples);
+        }
+    }
+    UnloadWave( wave);
+    if (loop.empty())
+    {
+        TraceLog( LOG_WARNING, "AUDIO: no engine sound in %s, engines stay silent", engineLoopPath);
+    }
+
+    EngineMixer *expected = nullptr;
+    if (not activeMixer.compare_exchange_strong( expected, this))
+    {
+        TraceLog( LOG_ERROR, "AUDIO: only one engine mixer can play at a time");
+    }
+
+    stream = LoadAudioStream( sampleRate, 32, 2);
+    SetAudioStreamCallback( stream, Mix);
+    PlayAudioStream( stream);
+}
+
+EngineMixer::~EngineMixer()
+{
+    // Once the stream is unloaded, the audio thread no longer calls Mix().
+    UnloadAudioStream( stream);
+    EngineMixer *expected = this;
+    activeMixer.compare_exchange_strong( expected, nullptr);
+}
+
+void EngineMixer::Update(
+    std::span<const Plane> planes,
+    WorldBounds world,
+    const Listeners &listeners)
+{
+    auto &next = voices.GetWriteBuffer();
+    std::array< float, maxVoices> gains;
+    next.count = 0;
+    for (std::size_t index = 0; index < planes.size(); ++index)
+    {
+        const auto &plane = planes[index];
+        if (plane.GetState() == Plane::Crashed)
+        {
+            continue;
+        }
+
+        const auto position = plane.GetPosition();
+        const float gain = GetGain( listeners, position, world);
+        if (gain <= 0.0f)
+        {
+            continue;
+        }
+
+        // When all voices are taken, replace the quietest one if this plane is louder.
+        std::size_t slot = next.count;
+        if (next.count == maxVoices)
+        {
+            slot = std::min_element( gains.begin(), gains.end()) - gains.begin();
+            if (gains[slot] >= gain)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            ++next.count;
+        }
+
+        const float pan = 0.75f - (position.x / world.width) / 2.0f;
+        const float speed = plane.GetSpeed();
+        gains[slot] = gain;
+        next.voices[slot] = {
+            static_cast<std::uint32_t>( index),
+            speed > 0.0f ? 1.0f - (plane.GetSpeedVector().y / speed) * 0.5f : 1.0f,
+            gain * GetPanLevel( pan),
+            gain * GetPanLevel( 1.0f - pan)};
+    }
+    voices.Publish();
+}
+
+void EngineMixer::Mix( void *buffer, unsigned int frames)
+{
+    float *samples = static_cast<float*>( buffer);
+    if (auto *mixer = activeMixer.load( std::memory_order_acquire))
+    {
+        mixer->MixInto( samples, frames);
+    }
+    else
+    {
+        std::fill( samples, samples + 2 * frames, 0.0f);
+    }
+}
+
+void EngineMixer::TakeNewVoices()
+{
+    if (not voices.Update())
+    {
+        return;
+    }
+
+    // Voices that are no longer chosen fade out, the others go to their new levels.
+    for (std::size_t index = 0; index < playingCount; ++index)
+    {
+        auto &target = playing[index].target;
+        target = { target.plane, target.pitch, 0.0f, 0.0f};
+    }
+
+    const auto &latest = voices.GetReadBuffer();
+    for (std::size_t voice = 0; voice < latest.count; ++voice)
+    {
+        const auto &target = latest.voices[voice];
+        const auto end = playing.begin() + playingCount;
+        const auto found = std::find_if( playing.begin(), end, [&]( const PlayingVoice &candidate) {
+            return candidate.target.plane == target.plane;
+        });
+        if (found != end)
+        {
+            found->target = target;
+        }
+        else if (playingCount < playing.size() and not loop.empty())
+        {
+            // New voices fade in, each at its own point in the loop so that they do not sound as one.
+            playing[playingCount++] = {
+                { target.plane, target.pitch, 0.0f, 0.0f},
+                target,
+                static_cast<float>( (target.plane * 7919u) % loop.size())};
+        }
+    }
+}
+
+void EngineMixer::MixInto( float *buffer, unsigned int frames)
+{
+    std::fill( buffer, buffer + 2 * frames, 0.0f);
+    TakeNewVoices();
+    if (loop.empty() or frames == 0)
+    {
+        return;
+    }
+
+    const float length = static_cast<float>( loop.size());
+    const float step = 1.0f / frames;
+    for (std::size_t index = 0; index < playingCount; ++index)
+    {
+        auto &voice = playing[index];
+        for (unsigned int frame = 0; frame < frames; ++frame)
+        {
+            const float fraction = (frame + 1) * step;
+            const auto sampleIndex = static_cast<std::size_t>( voice.position);
+            const auto nextIndex = sampleIndex + 1 < loop.size() ? sampleIndex + 1 : 0;
+            const float sample = Interpolate( loop[sampleIndex], loop[nextIndex], voice.position - sampleIndex);
+
+            buffer[2 * frame] += sample * Interpolate( voice.current.left, voice.target.left, fraction);
+            buffer[2 * frame + 1] += sample * Interpolate( voice.current.right, voice.target.right, fraction);
+
+            voice.position += Interpolate( voice.current.pitch, voice.target.pitch, fraction);
+            if (voice.position >= length)
+            {
+                voice.position -= length;
+            }
+        }
+        voice.current = voice.target;
+    }
+
+    // Forget the voices that have faded out.
+    const auto end = std::remove_if( playing.begin(), playing.begin() + playingCount, []( const PlayingVoice &voice) {
+        return voice.current.left == 0.0f and voice.current.right == 0.0f;
+    });
+    playingCount = end - playing.begin();
+
+    const float masterVolume = volume.load( std::memory_order_relaxed);
+    for (unsigned int sample = 0; sample < 2 * frames; ++sample)
+    {
+        buffer[sample] = Limit( buffer[sample] * masterVolume);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef ENGINE_MIXER_H
+#define ENGINE_MIXER_H
+
+#include "Listeners.h"
+#include "Plane.h"
+#include "raylib.h"
+#include "TripleBuffer.h"
+#include "WorldBounds.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Plays the engine sounds of all planes that can be heard, mixed into a
+ * single audio stream.
+ *
+ * The engine loop is decoded once. Each audible plane is a voice that plays
+ * the loop at its own speed, which sets its pitch, and with its own levels on
+ * the left and the right. raylib's audio thread calls the mixer to fill the
+ * stream, and the mixer adds all voices together in that one call.
+ *
+ * The game thread chooses the voices each frame in Update() and hands them to
+ * the audio thread in a triple buffer, so neither thread ever waits for the
+ * other. The audio thread ramps each voice from its previous levels to the
+ * new ones over a buffer, and fades out voices that were dropped, so changes
+ * do not click.
+ *
+ * raylib's stream callback does not pass any context, so there can be only
+ * one mixer at a time.
+ */
+class EngineMixer
+{
+public:
+    static constexpr std::size_t maxVoices = 16;
+    static constexpr unsigned int sampleRate = 44100;
+
+    explicit EngineMixer( const char *engineLoopPath);
+    ~EngineMixer();
+
+    EngineMixer( const EngineMixer&) = delete;
+    EngineMixer &operator=( const EngineMixer&) = delete;
+
+    void SetVolume( float volume) { this->volume.store( volume, std::memory_order_relaxed); }
+
+    /**
+     * Choose the planes to hear. The pitch of a plane follows whether it
+     * climbs or dives and its pan follows its horizontal position in the
+     * world, and its volume how close it is to a listener. Of the planes that
+     * can be heard, only the loudest maxVoices are played.
+     */
+    void Update( std::span<const Plane> planes, WorldBounds world, const Listeners &listeners);
+
+private:
+    struct Voice
+    {
+        std::uint32_t   plane;
+        float           pitch;
+        float           left;
+        float           right;
+    };
+
+    struct Voices
+    {
+        std::uint32_t                   count = 0;
+        std::array< Voice, maxVoices>   voices;
+    };
+
+    /// A voice as the audio thread plays it.
+    struct PlayingVoice
+    {
+        Voice   current;    ///< the levels at the end of the last buffer
+        Voice   target;     ///< the levels at the end of the next buffer
+        float   position;   ///< in frames of the engine loop
+    };
+
+    static void Mix( void *buffer, unsigned int frames);
+    void MixInto( float *buffer, unsigned int frames);
+    void TakeNewVoices();
+
+    std::vector<float>              loop;       ///< the engine sound, mono at sampleRate
+    AudioStream                     stream;
+    std::atomic<float>              volume{ 1.0f};
+    TripleBuffer<Voices>            voices;
+
+    // Only used by the audio thread. Dropped voices that are still fading out
+    // take up to maxVoices extra places.
+    std::array< PlayingVoice, 2 * maxVoices>    playing;
+    std::size_t                                 playingCount = 0;
+};
+
+#endif // ENGINE_MIXER_H
@@ -0,0 +1,302 @@
+#include "EventLog.h"
+
+#include "Plane.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+namespace { // unnamed
+
+    constexpr char headerMagic[8] = { 'P', 'L', 'A', 'N', 'E', 'E', 'V', 'T'};
+    constexpr std::uint32_t formatVersion = 1;
+
+    struct Header
+    {
+        char            magic[8];
+        std::uint32_t   version;
+        std::uint32_t   recordSize;
+    };
+
+    static_assert( std::is_trivially_copyable_v<EventRecord> and sizeof( EventRecord) == 32, "records are written as they are in memory, without padding");
+
+    std::atomic<std::uint64_t> nextLogId{ 1};
+
+    /// More planes than any game has. Records of planes beyond this are corrupt.
+    constexpr std::uint32_t maxReportedPlanes = 65536;
+
+    /// What a player did during the logged games.
+    struct PlayerStats
+    {
+        std::uint64_t shots = 0;
+        std::uint64_t hits = 0;
+        std::uint64_t deaths = 0;
+        std::uint64_t collisions = 0;
+    };
+}
+
+/**
+ * The records of one thread on their way to the file. Only the thread that
+ * records moves the head and only the drain thread moves the tail, each on
+ * its own cache line.
+ */
+struct EventLog::Ring
+{
+    static constexpr std::uint64_t mask = ringCapacity - 1;
+    static_assert( (ringCapacity & mask) == 0, "the ring capacity must be a power of two");
+
+    explicit Ring( std::thread::id owner) : owner( owner) {}
+
+    const std::thread::id               owner;
+    alignas( 64) std::atomic<std::uint64_t> head{ 0};
+    alignas( 64) std::atomic<std::uint64_t> tail{ 0};
+    std::array< EventRecord, ringCapacity> records;
+};
+
+EventLog::EventLog( const char *path)
+    : file( std::fopen( path, "wb")),
+    id( nextLogId.fetch_add( 1, std::memory_order_relaxed))
+{
+    if (not file)
+    {
+        TraceLog( LOG_ERROR, "EVENTS: cannot open %s for writing", path);
+        return;
+    }
+
+    Header header = {};
+    std::memcpy( header.magic, headerMagic, sizeof( headerMagic));
+    header.version = formatVersion;
+    header.recordSize = sizeof( EventRecord);
+    std::fwrite( &header, sizeof( header), 1, file);
+
+    drainer = std::thread( [this]{ Drain(); });
+}
+
+EventLog::~EventLog()
+{
+    if (not file)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock( mutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    drainer.join();
+    std::fclose( file);
+
+    if (const auto count = GetDroppedCount())
+    {
+        TraceLog( LOG_WARNING, "EVENTS: dropped %llu records because the log could not keep up", static_cast<unsigned long long>( count));
+    }
+}
+
+void EventLog::Record( const EventRecord &record)
+{
+    if (not file)
+    {
+        return;
+    }
+
+    auto &ring = GetRing();
+    const auto head = ring.head.load( std::memory_order_relaxed);
+    const auto used = head - ring.tail.load( std::memory_order_acquire);
+    if (used == ringCapacity)
+    {
+        dropped.fetch_add( 1, std::memory_order_relaxed);
+        return;
+    }
+    ring.records[head & Ring::mask] = record;
+    ring.head.store( head + 1, std::memory_order_release);
+
+    // Don't wait for the next drain when the ring fills up quickly. Should
+    // the drain thread miss this, it still drains at its next interval.
+    if (used + 1 == ringCapacity / 2)
+    {
+        wakeUp.notify_one();
+    }
+}
+
+EventLog::Ring &EventLog::GetRing()
+{
+    // Remember the ring of the thread for the log that it last recorded to.
+    thread_local std::uint64_t cachedLog = 0;
+    thread_local Ring *cachedRing = nullptr;
+    if (cachedLog != id)
+    {
+        cachedRing = &AddRing();
+        cachedLog = id;
+    }
+    return *cachedRing;
+}
+
+EventLog::Ring &EventLog::AddRing()
+{
+    std::lock_guard lock( mutex);
+    const auto owner = std::this_thread::get_id();
+    const auto ring = std::find_if( rings.begin(), rings.end(), [owner]( const auto &ring) {
+        return ring->owner == owner;
+    });
+    if (ring != rings.end())
+    {
+        return **ring;
+    }
+    return *rings.emplace_back( std::make_unique<Ring>( owner));
+}
+
+void EventLog::Drain()
+{
+    std::unique_lock lock( mutex);
+    for (;;)
+    {
+        // Once stopping, nobody records anymore, so this drains the last records.
+        const bool stop = stopping;
+        for (const auto &ring : rings)
+        {
+            DrainRing( *ring);
+        }
+        if (stop)
+        {
+            break;
+        }
+        wakeUp.wait_for( lock, drainInterval);
+    }
+}
+
+void EventLog::DrainRing( Ring &ring)
+{
+    const auto tail = ring.tail.load( std::memory_order_relaxed);
+    const auto head = ring.head.load( std::memory_order_acquire);
+    if (head == tail)
+    {
+        return;
+    }
+
+    // The records may wrap around the end of the ring.
+    const auto first = tail & Ring::mask;
+    const auto count = head - tail;
+    const auto untilEnd = std::min( count, ringCapacity - first);
+    std::fwrite( &ring.records[first], sizeof( EventRecord), untilEnd, file);
+    std::fwrite( &ring.records[0], sizeof( EventRecord), count - untilEnd, file);
+    ring.tail.store( head, std::memory_order_release);
+}
+
+bool ReportEventLog( const char *logPath, const char *csvPath)
+{
+    std::FILE *log = std::fopen( logPath, "rb");
+    if (not log)
+    {
+        TraceLog( LOG_ERROR, "EVENTS: cannot open %s", logPath);
+        return false;
+    }
+
+    Header header;
+    if (std::fread( &header, sizeof( header), 1, log) != 1
+        or std::memcmp( header.magic, headerMagic, sizeof( headerMagic)) != 0
+        or header.version != formatVersion
+        or header.recordSize != sizeof( EventRecord))
+    {
+        TraceLog( LOG_ERROR, "EVENTS: %s is not an event log of this version", logPath);
+        std::fclose( log);
+        return false;
+    }
+
+    std::vector<PlayerStats> players;
+    const auto getPlayer = [&players]( std::uint32_t plane) -> PlayerStats& {
+        if (plane >= players.size())
+        {
+            players.resize( plane + 1);
+        }
+        return players[plane];
+    };
+
+    std::vector<EventRecord> records( 4096);
+    std::uint64_t recordCount = 0;
+    std::uint64_t malformedCount = 0;
+    while (const auto count = std::fread( records.data(), sizeof( EventRecord), records.size(), log))
+    {
+        recordCount += count;
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            // Skip records that do not name the planes that their kind needs,
+            // rather than make room for billions of players.
+            const auto &record = records[index];
+            const bool twoPlanes = record.kind == EventRecord::Collision;
+            if (record.kind > EventRecord::Respawn
+                or record.plane >= maxReportedPlanes
+                or (twoPlanes and record.other >= maxReportedPlanes))
+            {
+                ++malformedCount;
+                continue;
+            }
+
+            switch (record.kind)
+            {
+            case EventRecord::Shot:
+                ++getPlayer( record.plane).shots;
+                break;
+
+            case EventRecord::Hit:
+                ++getPlayer( record.plane).hits;
+                break;
+
+            case EventRecord::Collision:
+                ++getPlayer( record.plane).collisions;
+                ++getPlayer( record.other).collisions;
+                break;
+
+            case EventRecord::StateChange:
+                // Every plane that is brought down starts crashing.
+                if (record.from == Plane::Flying and record.to == Plane::Crashing)
+                {
+                    ++getPlayer( record.plane).deaths;
+                }
+                break;
+
+            case EventRecord::Respawn:
+                break;
+            }
+        }
+    }
+    std::fclose( log);
+    if (malformedCount)
+    {
+        TraceLog(
+            LOG_WARNING, "EVENTS: skipped %llu malformed records in %s",
+            static_cast<unsigned long long>( malformedCount), logPath);
+    }
+
+    std::FILE *csv = csvPath ? std::fopen( csvPath, "w") : stdout;
+    if (not csv)
+    {
+        TraceLog( LOG_ERROR, "EVENTS: cannot open %s for writing", csvPath);
+        return false;
+    }
+
+    // Every hit brings a plane down, so hits are kills.
+    std::fprintf( csv, "player,shots,hits,accuracy,kills,deaths,collisions,kills_per_death\n");
+    for (std::size_t player = 0; player < players.size(); ++player)
+    {
+        const auto &stats = players[player];
+        std::fprintf(
+            csv, "%zu,%llu,%llu,%.3f,%llu,%llu,%llu,%.3f\n",
+            player,
+            static_cast<unsigned long long>( stats.shots),
+            static_cast<unsigned long long>( stats.hits),
+            stats.shots ? static_cast<double>( stats.hits) / stats.shots : 0.0,
+            static_cast<unsigned long long>( stats.hits),
+            static_cast<unsigned long long>( stats.deaths),
+            static_cast<unsigned long long>( stats.collisions),
+            static_cast<double>( stats.hits) / std::max<std::uint64_t>( stats.deaths, 1));
+    }
+    if (csvPath)
+    {
+        std::fclose( csv);
+    }
+
+    TraceLog( LOG_INFO, "EVENTS: %llu records of %zu players in %s", static_cast<unsigned long long>( recordCount), players.size(), logPath);
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "raylib.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A gameplay event as it is written to an event log, for analytics. All
+ * records have the same size, so that a log can be read in blocks and
+ * indexed by record.
+ */
+struct EventRecord
+{
+    static constexpr std::uint32_t nobody = 0xffffffff;   ///< 'other' of events with only one plane
+
+    enum Kind : std::uint8_t
+    {
+        Shot,           ///< 'plane' fired a bullet
+        Hit,            ///< a bullet of 'plane' brought down 'other'
+        Collision,      ///< 'plane' and 'other' collided, which brings down both
+        StateChange,    ///< 'plane' went from state 'from' to state 'to'
+        Respawn         ///< 'plane' respawned for its next generation
+    };
+
+    std::uint64_t   tick;           ///< the number of times that the planes had moved
+    Vector2         position;       ///< where it happened
+    std::uint32_t   plane;
+    std::uint32_t   other;
+    std::uint32_t   generation;     ///< the life of 'plane' in which it happened
+    Kind            kind;
+    std::uint8_t    from;           ///< the Plane::State before a state change
+    std::uint8_t    to;             ///< the Plane::State after a state change
+    std::uint8_t    reserved;
+};
+
+/**
+ * Writes gameplay events to a binary file, at a cost to the tick of little
+ * more than copying the record.
+ *
+ * Each thread that records events gets its own lock-free ring buffer, which a
+ * background thread drains to the file every few milliseconds, or as soon as
+ * a ring is half full. Recording never waits: when a ring is full, because
+ * the disk cannot keep up, the record is dropped and counted. The first
+ * record of a thread allocates its ring, after that recording does not
+ * allocate.
+ *
+ * The file starts with a small header, followed by the records of all threads
+ * in the order in which they were drained, so records are only in order per
+ * thread.
+ */
+class EventLog
+{
+public:
+    static constexpr std::size_t ringCapacity = 16384;  ///< records per thread, a power of two
+
+    explicit EventLog( const char *path);
+    ~EventLog();
+
+    EventLog( const EventLog&) = delete;
+    EventLog &operator=( const EventLog&) = delete;
+
+    bool IsOpen() const { return file != nullptr; }
+
+    /// Record an event from the calling thread.
+    void Record( const EventRecord &record);
+
+    /// The number of records that were dropped because a ring was full.
+    std::uint64_t GetDroppedCount() const { return dropped.load( std::memory_order_relaxed); }
+
+private:
+    struct Ring;
+
+    static constexpr auto drainInterval = std::chrono::milliseconds( 5);
+
+    Ring &GetRing();
+    Ring &AddRing();
+    void Drain();
+    void DrainRing( Ring &ring);
+
+    std::FILE                          *file = nullptr;
+    const std::uint64_t                 id;     ///< tells the rings of this log apart from those of earlier ones
+    std::mutex                          mutex;  ///< guards the list of rings and waking up the drain thread
+    std::condition_variable             wakeUp;
+    bool                                stopping = false;
+    std::vector<std::unique_ptr<Ring>>  rings;
+    std::atomic<std::uint64_t>          dropped{ 0};
+    std::thread                         drainer;
+};
+
+/**
+ * Read an event log and write one CSV row per player, with their shots, hits
+ * and accuracy, kills, deaths and collisions, to the file csvPath, or to
+ * stdout if csvPath is null. Records that name no valid plane are skipped and
+ * counted. Returns false if the log cannot be read.
+ */
+bool ReportEventLog( const char *logPath, const char *csvPath);
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,56 @@
+#ifndef FLOAT4_H
+#define FLOAT4_H
+
+/**
+ * Four floats in one SIMD register, for the kernels that do the same math on
+ * the x and y coordinates of two things at once.
+ *
+ * These are the vector extensions of GCC and Clang, which compile to SSE on
+ * x86, to NEON on ARM and to 128-bit SIMD on WebAssembly built with
+ * -msimd128. PLANES_SIMD is defined where that is what they compile to,
+ * unless PLANES_NO_SIMD is defined. The kernels keep a scalar version for
+ * other targets, which does the same operations in the same order, so that
+ * both give the same results to the bit, as replays require.
+ */
+#if not defined( PLANES_NO_SIMD) and defined( __GNUC__) \
+    and (defined( __wasm_simd128__) or defined( __SSE2__) or defined( __ARM_NEON))
+#define PLANES_SIMD 1
+
+#include "raylib.h"
+
+#include <bit>
+#include <cstdint>
+
+using Float4 = float __attribute__(( vector_size( 16)));
+using Mask4 = std::int32_t __attribute__(( vector_size( 16)));
+
+/// The lanes of ifTrue where the mask is set, those of ifFalse elsewhere.
+inline Float4 Select( Mask4 mask, Float4 ifTrue, Float4 ifFalse)
+{
+    return std::bit_cast<Float4>( (mask & std::bit_cast<Mask4>( ifTrue)) | (~mask & std::bit_cast<Mask4>( ifFalse)));
+}
+
+/// Wrap() of every lane.
+inline Float4 Wrap( Float4 value, Float4 max)
+{
+    return Select( value < 0.0f, value + max, Select( value >= max, value - max, value));
+}
+
+inline Float4 Abs( Float4 value)
+{
+    return std::bit_cast<Float4>( std::bit_cast<Mask4>( value) & 0x7fffffff);
+}
+
+/// The upper two lanes, twice. For a Rectangle, that is its width and height.
+inline Float4 SpreadHigh( Float4 value)
+{
+    return __builtin_shufflevector( value, value, 2, 3, 2, 3);
+}
+
+inline Float4 Combine( Vector2 low, Vector2 high) { return Float4{ low.x, low.y, high.x, high.y}; }
+inline Vector2 GetLow( Float4 value) { return { value[0], value[1]}; }
+inline Vector2 GetHigh( Float4 value) { return { value[2], value[3]}; }
+
+#endif // SIMD
+
+#endif // FLOAT4_H
@@ -0,0 +1,157 @@
+#include "FramePacer.h"
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    constexpr int fallbackRefreshRate = 60;
+
+    /// What each of the calibration sleeps asks for.
+    constexpr auto calibrationSleep = std::chrono::milliseconds( 1);
+    constexpr int calibrationSleeps = 20;
+
+    /// Bounds of the time to spin before a deadline, whatever the calibration measures.
+    constexpr auto minimumSpinTime = std::chrono::microseconds( 200);
+    constexpr auto maximumSpinTime = std::chrono::milliseconds( 4);
+
+    /// A present that returns later than this after it was called waited for a vsync.
+    constexpr auto blockingPresent = std::chrono::microseconds( 500);
+}
+
+FramePacer::FramePacer()
+{
+    refreshRate = fallbackRefreshRate;
+    if constexpr (enabled)
+    {
+        refreshRate = GetMonitorRefreshRate( GetCurrentMonitor());
+        if (refreshRate <= 0)
+        {
+            refreshRate = fallbackRefreshRate;
+        }
+    }
+    refreshInterval = 1.0 / refreshRate;
+
+    spinTime = maximumSpinTime;
+    if constexpr (enabled)
+    {
+        Calibrate();
+        TraceLog(
+            LOG_INFO, "PACER: %d Hz, spinning for the last %.2f ms before a deadline",
+            refreshRate, std::chrono::duration<double, std::milli>( spinTime).count());
+    }
+
+    inputTime = previousInputTime = presentTime = Clock::now();
+    nextVsync = inputTime + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( refreshInterval));
+}
+
+void FramePacer::Calibrate()
+{
+    Clock::duration worstOvershoot = Clock::duration::zero();
+    for (int sleep = 0; sleep < calibrationSleeps; ++sleep)
+    {
+        const auto start = Clock::now();
+        std::this_thread::sleep_for( calibrationSleep);
+        worstOvershoot = std::max( worstOvershoot, Clock::now() - start - calibrationSleep);
+    }
+
+    // Spin for somewhat longer than the worst wake-up that was measured, a
+    // busy system wakes up later than an idle one.
+    spinTime = std::clamp<Clock::duration>( worstOvershoot + worstOvershoot / 2, minimumSpinTime, maximumSpinTime);
+}
+
+void FramePacer::SleepUntil( Clock::time_point deadline) const
+{
+    for (auto now = Clock::now(); now < deadline; now = Clock::now())
+    {
+        if (deadline - now > spinTime)
+        {
+            std::this_thread::sleep_for( deadline - now - spinTime);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+FramePacer::Clock::duration FramePacer::GetWorkEstimate() const
+{
+    return *std::max_element( workHistory.begin(), workHistory.end());
+}
+
+void FramePacer::BeginFrame()
+{
+    if constexpr (enabled)
+    {
+        const auto margin = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( safetyMargin));
+        SleepUntil( nextVsync - GetWorkEstimate() - margin);
+
+        PollInputEvents();
+        inputSampled = true;
+        previousInputTime = inputTime;
+        inputTime = Clock::now();
+    }
+}
+
+void FramePacer::EndFrame()
+{
+    if constexpr (enabled)
+    {
+        // With custom frame control, EndDrawing() only finishes the batch of
+        // drawing commands, presenting is up to us.
+        EndDrawing();
+        const auto presentStart = Clock::now();
+        workHistory[workIndex] = presentStart - inputTime;
+        workIndex = (workIndex + 1) % workHistoryLength;
+
+        SwapScreenBuffer();
+        const auto presentEnd = Clock::now();
+        presentTime = presentEnd;
+        inputLatency = std::chrono::duration<double>( presentEnd - inputTime).count();
+
+        // A present that waited returned at a vsync, the next one follows a
+        // refresh interval later. Otherwise the driver does not wait for
+        // vsync and the deadlines stay on the grid that they were on,
+        // skipping the ones that have passed.
+        const auto interval = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( refreshInterval));
+        if (presentEnd - presentStart > blockingPresent)
+        {
+            nextVsync = presentEnd + interval;
+        }
+        else
+        {
+            do
+            {
+                nextVsync += interval;
+            } while (nextVsync <= presentEnd);
+        }
+    }
+    else
+    {
+        // raylib presents at the start of EndDrawing(), then waits for the
+        // next frame and only then polls input. In a browser, the frame is
+        // presented when the callback returns, and input arrives in between
+        // callbacks.
+        presentTime = Clock::now();
+        if (inputSampled)
+        {
+            inputLatency = std::chrono::duration<double>( presentTime - inputTime).count();
+        }
+        EndDrawing();
+        inputSampled = true;
+        previousInputTime = inputTime;
+        inputTime = Clock::now();
+    }
+}
+
+float FramePacer::GetFrameTime() const
+{
+    if constexpr (enabled)
+    {
+        return std::chrono::duration<float>( inputTime - previousInputTime).count();
+    }
+    return ::GetFrameTime();
+}
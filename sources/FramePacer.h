@@ -0,0 +1,91 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Paces the frames to the display and samples input as late as it can, to
+ * keep the time from a key press to the frame that shows it short.
+ *
+ * By default, raylib presents a frame, waits until the next frame is due and
+ * polls input, all in EndDrawing(). When raylib is built with
+ * SUPPORT_CUSTOM_FRAME_CONTROL, the pacer does those steps itself instead:
+ *
+ *  - BeginFrame() sleeps until the predicted deadline of the next vsync,
+ *    minus what updating and drawing a frame has recently taken and a
+ *    safety margin, and only then polls input.
+ *  - EndFrame() presents the frame and learns from when the present returns
+ *    where the vsyncs are.
+ *
+ * Sleeping is precise to a few microseconds: the pacer sleeps through the
+ * bulk of a wait and spins for the last part, whose length is calibrated at
+ * startup from how late the operating system wakes up a sleeping thread.
+ *
+ * Without custom frame control, the pacer leaves the pacing to raylib but
+ * still measures the time from sampling input to presenting.
+ */
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+#if defined( SUPPORT_CUSTOM_FRAME_CONTROL)
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    /// Time left between the end of drawing and the vsync, for when a frame takes a little longer than the last ones.
+    static constexpr double safetyMargin = 0.001;
+
+    /// Paces to the refresh rate of the current monitor, or to 60 Hz if that is unknown or raylib paces the frames.
+    FramePacer();
+
+    /// Wait for the last moment to sample input, then sample it.
+    void BeginFrame();
+
+    /// Present the frame. Call this rather than EndDrawing().
+    void EndFrame();
+
+    /// The seconds that the frame should simulate: the time between the last two input samples.
+    float GetFrameTime() const;
+
+    /// Seconds from sampling the input to presenting the frame that shows its effect, for the last frame, or zero before the first.
+    double GetInputLatency() const { return inputLatency; }
+
+    /// When the input of the current frame was sampled.
+    Clock::time_point GetInputTime() const { return inputTime; }
+
+    /// When the last frame was presented, as far as the pacer can tell.
+    Clock::time_point GetPresentTime() const { return presentTime; }
+
+    int GetRefreshRate() const { return refreshRate; }
+
+private:
+    /// Sleep for the bulk of the time, spin for the rest.
+    void SleepUntil( Clock::time_point deadline) const;
+
+    /// Measure how late a thread wakes up after sleeping.
+    void Calibrate();
+
+    /// The time that updating and drawing a frame can be expected to take.
+    Clock::duration GetWorkEstimate() const;
+
+    static constexpr std::size_t workHistoryLength = 32;
+
+    int                 refreshRate;
+    double              refreshInterval;
+    Clock::duration     spinTime;       ///< spin rather than sleep when this close to a deadline
+    Clock::time_point   inputTime;      ///< when input was sampled for the current frame
+    Clock::time_point   previousInputTime;
+    Clock::time_point   presentTime;
+    Clock::time_point   nextVsync;      ///< predicted
+    std::array<Clock::duration, workHistoryLength> workHistory = {};
+    std::size_t         workIndex = 0;
+    double              inputLatency = 0.0;
+    bool                inputSampled = false;   ///< whether inputTime is the time of an input sample yet
+};
+
+#endif // FRAME_PACER_H
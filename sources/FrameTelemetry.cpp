@@ -0,0 +1,213 @@
+#include "FrameTelemetry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    constexpr double millisecondsPerSecond = 1000.0;
+}
+
+std::size_t DurationHistogram::GetBucketIndex( std::uint64_t microseconds)
+{
+    if (microseconds < linearBuckets)
+    {
+        return static_cast<std::size_t>( microseconds);
+    }
+
+    // Keep the six most significant bits. The top bit is always set, so the
+    // remaining five select one of 32 sub-buckets of this power of two.
+    const auto shift = static_cast<std::size_t>( std::bit_width( microseconds)) - 6;
+    const auto top = static_cast<std::size_t>( microseconds >> shift);
+    const auto index = linearBuckets + (shift - 1) * subBuckets + (top - subBuckets);
+    return std::min( index, bucketCount - 1);
+}
+
+std::uint64_t DurationHistogram::GetBucketUpperBound( std::size_t index)
+{
+    if (index < linearBuckets)
+    {
+        return index;
+    }
+
+    const auto shift = (index - linearBuckets) / subBuckets + 1;
+    const auto top = (index - linearBuckets) % subBuckets + subBuckets;
+    return ((top + 1) << shift) - 1;
+}
+
+void DurationHistogram::Record( double seconds)
+{
+    const auto microseconds = static_cast<std::uint64_t>( std::max( seconds, 0.0) * 1e6 + 0.5);
+    ++buckets[GetBucketIndex( microseconds)];
+    ++count;
+    maxMicroseconds = std::max( maxMicroseconds, microseconds);
+}
+
+void DurationHistogram::Reset()
+{
+    buckets = {};
+    count = 0;
+    maxMicroseconds = 0;
+}
+
+double DurationHistogram::GetPercentile( double percentage) const
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+
+    // The number of values that must lie at or below the reported bucket.
+    const auto wanted = static_cast<std::size_t>( std::ceil( std::clamp( percentage, 0.0, 100.0) / 100.0 * count));
+    std::size_t seen = 0;
+    for (std::size_t index = 0; index < bucketCount; ++index)
+    {
+        seen += buckets[index];
+        if (seen >= wanted and seen > 0)
+        {
+            return std::min( GetBucketUpperBound( index), maxMicroseconds) / 1e6;
+        }
+    }
+    return GetMax();
+}
+
+FrameTelemetry::FrameTelemetry( int targetFps)
+    : targetInterval( 1.0 / targetFps)
+{
+}
+
+void FrameTelemetry::BeginFrame( float reportedFrameTime)
+{
+    const auto now = Clock::now();
+    if (hasPreviousFrame)
+    {
+        const auto wallTime = SecondsBetween( frameStart, now);
+        histograms[Frame].Record( wallTime);
+        histograms[Jitter].Record( std::abs( wallTime - reportedFrameTime));
+
+        if (wallTime > 1.5 * targetInterval)
+        {
+            ++missedVsyncs;
+        }
+
+        recentFrameTimes[recentFrameIndex] = static_cast<float>( wallTime);
+        recentFrameIndex = (recentFrameIndex + 1) % sparklineLength;
+    }
+    hasPreviousFrame = true;
+    frameStart = now;
+}
+
+void FrameTelemetry::EndUpdate()
+{
+    updateEnd = Clock::now();
+    histograms[Update].Record( SecondsBetween( frameStart, updateEnd));
+}
+
+void FrameTelemetry::EndDraw()
+{
+    histograms[Draw].Record( SecondsBetween( updateEnd, Clock::now()));
+}
+
+void FrameTelemetry::RecordLatency( double seconds)
+{
+    histograms[Latency].Record( seconds);
+}
+
+void FrameTelemetry::Reset()
+{
+    for (auto &histogram : histograms)
+    {
+        histogram.Reset();
+    }
+    recentFrameTimes = {};
+    missedVsyncs = 0;
+}
+
+const char *GetSeriesName( FrameTelemetry::Series series)
+{
+    switch (series)
+    {
+        case FrameTelemetry::Frame:         return "frame";
+        case FrameTelemetry::Update:        return "update";
+        case FrameTelemetry::Draw:          return "draw";
+        case FrameTelemetry::Jitter:        return "jitter";
+        case FrameTelemetry::Latency:       return "latency";
+        case FrameTelemetry::SeriesCount:   break;
+    }
+    return "unknown";
+}
+
+void DrawFrameTelemetry( const FrameTelemetry &telemetry, Vector2 position)
+{
+    const int fontSize = 10;
+    const int lineHeight = fontSize + 2;
+    const int left = static_cast<int>( position.x);
+    int top = static_cast<int>( position.y);
+
+    DrawText(
+        TextFormat( "%-7s %7s %7s %7s %7s (ms)", "", "p50", "p95", "p99", "max"),
+        left, top, fontSize, BLACK);
+    for (int series = 0; series < FrameTelemetry::SeriesCount; ++series)
+    {
+        top += lineHeight;
+        const auto &histogram = telemetry.GetHistogram( static_cast<FrameTelemetry::Series>( series));
+        DrawText(
+            TextFormat(
+                "%-7s %7.2f %7.2f %7.2f %7.2f",
+                GetSeriesName( static_cast<FrameTelemetry::Series>( series)),
+                histogram.GetPercentile( 50) * millisecondsPerSecond,
+                histogram.GetPercentile( 95) * millisecondsPerSecond,
+                histogram.GetPercentile( 99) * millisecondsPerSecond,
+                histogram.GetMax() * millisecondsPerSecond),
+            left, top, fontSize, BLACK);
+    }
+    top += lineHeight;
+    DrawText( TextFormat( "missed vsyncs: %zu", telemetry.GetMissedVsyncCount()), left, top, fontSize, BLACK);
+
+    // Sparkline of the most recent frame times, oldest on the left. The scale
+    // is such that the target frame interval is at half the height, which is
+    // marked with a horizontal line.
+    top += lineHeight + 2;
+    const int sparklineHeight = 40;
+    const int bottom = top + sparklineHeight;
+    const float pixelsPerSecond = sparklineHeight / (2.0f * static_cast<float>( telemetry.GetTargetInterval()));
+    DrawRectangle( left, top, static_cast<int>( FrameTelemetry::sparklineLength), sparklineHeight, Fade( WHITE, 0.5f));
+    for (std::size_t age = 0; age < FrameTelemetry::sparklineLength; ++age)
+    {
+        const auto frameTime = telemetry.GetRecentFrameTime( age);
+        const int x = left + static_cast<int>( FrameTelemetry::sparklineLength - 1 - age);
+        const int lineLength = std::min( static_cast<int>( frameTime * pixelsPerSecond), sparklineHeight);
+        DrawLine( x, bottom, x, bottom - lineLength, frameTime > 1.5 * telemetry.GetTargetInterval() ? RED : DARKGREEN);
+    }
+    DrawLine(
+        left, bottom - sparklineHeight / 2,
+        left + static_cast<int>( FrameTelemetry::sparklineLength), bottom - sparklineHeight / 2,
+        BLACK);
+}
+
+const char *FormatFrameTelemetry( const FrameTelemetry &telemetry)
+{
+    static std::array<char, 2048> buffer;
+
+    int length = std::snprintf(
+        buffer.data(), buffer.size(), "{\"missedVsyncs\":%zu", telemetry.GetMissedVsyncCount());
+    for (int series = 0; series < FrameTelemetry::SeriesCount and length < static_cast<int>( buffer.size()); ++series)
+    {
+        const auto &histogram = telemetry.GetHistogram( static_cast<FrameTelemetry::Series>( series));
+        length += std::snprintf(
+            buffer.data() + length, buffer.size() - length,
+            ",\"%s\":{\"count\":%zu,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+            GetSeriesName( static_cast<FrameTelemetry::Series>( series)),
+            histogram.GetCount(),
+            histogram.GetPercentile( 50) * millisecondsPerSecond,
+            histogram.GetPercentile( 95) * millisecondsPerSecond,
+            histogram.GetPercentile( 99) * millisecondsPerSecond,
+            histogram.GetMax() * millisecondsPerSecond);
+    }
+    if (length < static_cast<int>( buffer.size()))
+    {
+        std::snprintf( buffer.data() + length, buffer.size() - length, "}");
+    }
+    return buffer.data();
+}
@@ -0,0 +1,122 @@
+#ifndef FRAME_TELEMETRY_H
+#define FRAME_TELEMETRY_H
+
+#include "raylib.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Histogram of durations with a bounded relative error, in the style of an
+ * HDR histogram.
+ *
+ * Durations are recorded with microsecond resolution. Values below 64us get a
+ * bucket of their own, larger values are grouped per power of two, with each
+ * power of two split into 32 linear sub-buckets. That keeps the error of any
+ * reported percentile below about 3% over the whole range from a microsecond
+ * up to more than a minute, in a fixed amount of memory.
+ */
+class DurationHistogram
+{
+public:
+    void Record( double seconds);
+    void Reset();
+
+    /// Returns the duration in seconds below which the given percentage (0-100) of the recorded durations lie.
+    double GetPercentile( double percentage) const;
+    double GetMax() const { return maxMicroseconds / 1e6; }
+    std::size_t GetCount() const { return count; }
+
+private:
+    static constexpr std::size_t linearBuckets = 64;
+    static constexpr std::size_t subBuckets = 32;
+    static constexpr std::size_t octaves = 26;
+    static constexpr std::size_t bucketCount = linearBuckets + octaves * subBuckets;
+
+    static std::size_t GetBucketIndex( std::uint64_t microseconds);
+    static std::uint64_t GetBucketUpperBound( std::size_t index);
+
+    std::array<std::uint32_t, bucketCount> buckets = {};
+    std::size_t     count = 0;
+    std::uint64_t   maxMicroseconds = 0;
+};
+
+/**
+ * Collects frame pacing statistics.
+ *
+ * For every frame this records the wall time between the starts of
+ * consecutive frames, the time spent updating the world, the time spent
+ * drawing it and the difference between the wall time and what raylib reports
+ * through GetFrameTime(). Frames that took longer than one and a half times the
+ * target frame interval are counted as missed vsyncs. The time from sampling
+ * input to presenting a frame is recorded as the latency, see FramePacer.
+ */
+class FrameTelemetry
+{
+public:
+    enum Series
+    {
+        Frame,
+        Update,
+        Draw,
+        Jitter,
+        Latency,
+        SeriesCount
+    };
+
+    static constexpr std::size_t sparklineLength = 120;
+
+    explicit FrameTelemetry( int targetFps = 60);
+
+    void BeginFrame( float reportedFrameTime);
+    void EndUpdate();
+    void EndDraw();
+    void RecordLatency( double seconds);
+    void Reset();
+
+    const DurationHistogram &GetHistogram( Series series) const { return histograms[series]; }
+    std::size_t GetMissedVsyncCount() const { return missedVsyncs; }
+    double GetTargetInterval() const { return targetInterval; }
+
+    /// Wall time of the frame that was recorded 'age' frames ago, in seconds.
+    float GetRecentFrameTime( std::size_t age) const
+    {
+        return recentFrameTimes[(recentFrameIndex + sparklineLength - 1 - age) % sparklineLength];
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double SecondsBetween( Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double>( end - start).count();
+    }
+
+    std::array<DurationHistogram, SeriesCount> histograms;
+    std::array<float, sparklineLength> recentFrameTimes = {};
+    std::size_t         recentFrameIndex = 0;
+    std::size_t         missedVsyncs = 0;
+    double              targetInterval;
+    bool                hasPreviousFrame = false;
+    Clock::time_point   frameStart;
+    Clock::time_point   updateEnd;
+};
+
+const char *GetSeriesName( FrameTelemetry::Series series);
+
+/**
+ * Draw the percentiles of all series and a sparkline of the most recent frame
+ * times, with the top left corner at the given position.
+ */
+void DrawFrameTelemetry( const FrameTelemetry &telemetry, Vector2 position);
+
+/**
+ * Format a summary of the telemetry as a JSON object.
+ *
+ * The result is stored in a static buffer that is overwritten by the next call.
+ */
+const char *FormatFrameTelemetry( const FrameTelemetry &telemetry);
+
+#endif // FRAME_TELEMETRY_H
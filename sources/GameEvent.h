@@ -0,0 +1,29 @@
+#ifndef GAME_EVENT_H
+#define GAME_EVENT_H
+
+#include "raylib.h"
+
+#include <cstdint>
+
+/**
+ * Something that happened in the simulation that the world outside it may
+ * want to react to, for instance by playing a sound.
+ *
+ * The simulation records events while it applies its commands and keeps them
+ * until the start of the next tick, so that the game can read them once the
+ * tick is done.
+ */
+struct GameEvent
+{
+    enum Kind : std::uint8_t
+    {
+        Shot,       ///< a plane fired a bullet
+        PlaneDown   ///< a plane was hit and started crashing
+    };
+
+    Kind            kind;
+    std::uint32_t   plane;
+    Vector2         position;
+};
+
+#endif // GAME_EVENT_H
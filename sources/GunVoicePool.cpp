@@ -0,0 +1,91 @@
+#include "GunVoicePool.h"
+
+#include <algorithm>
+
+GunVoicePool::GunVoicePool( const char *gunSoundPath)
+    : sound( LoadSound( gunSoundPath)),
+    duration( sound.stream.sampleRate > 0 ? static_cast<float>( sound.frameCount) / sound.stream.sampleRate : 0.0f)
+{
+    for (auto &voice : voices)
+    {
+        voice.sound = LoadSoundAlias( sound);
+    }
+}
+
+GunVoicePool::~GunVoicePool()
+{
+    for (auto &voice : voices)
+    {
+        UnloadSoundAlias( voice.sound);
+    }
+    UnloadSound( sound);
+}
+
+float GunVoicePool::GetPriority( const Voice &voice, double time) const
+{
+    if (not IsSoundPlaying( voice.sound) or duration <= 0.0f)
+    {
+        return 0.0f;
+    }
+    const float remaining = 1.0f - static_cast<float>( time - voice.startTime) / duration;
+    return voice.gain * std::max( remaining, 0.0f);
+}
+
+void GunVoicePool::Play( std::span<const GameEvent> events, WorldBounds world, const Listeners &listeners, double time)
+{
+    // Keep the loudest shots of the frame.
+    std::size_t shotCount = 0;
+    for (const auto &event : events)
+    {
+        if (event.kind != GameEvent::Shot)
+        {
+            continue;
+        }
+        const float gain = GetGain( listeners, event.position, world);
+        if (gain <= 0.0f)
+        {
+            continue;
+        }
+
+        std::size_t slot = shotCount;
+        if (shotCount == shots.size())
+        {
+            slot = std::min_element( shots.begin(), shots.end(), []( const Shot &a, const Shot &b) {
+                return a.gain < b.gain;
+            }) - shots.begin();
+            if (shots[slot].gain >= gain)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            ++shotCount;
+        }
+        shots[slot] = { event.position, gain};
+    }
+
+    // Play the loudest first, so that they win from the others when voices are stolen.
+    std::sort( shots.begin(), shots.begin() + shotCount, []( const Shot &a, const Shot &b) {
+        return a.gain > b.gain;
+    });
+    for (std::size_t shot = 0; shot < shotCount; ++shot)
+    {
+        const auto &[position, gain] = shots[shot];
+        const auto voice = std::min_element( voices.begin(), voices.end(), [&]( const Voice &a, const Voice &b) {
+            return GetPriority( a, time) < GetPriority( b, time);
+        });
+        if (GetPriority( *voice, time) >= gain)
+        {
+            // All voices are busy with something louder, and so are the rest of the shots.
+            break;
+        }
+
+        StopSound( voice->sound);
+        SetSoundVolume( voice->sound, gain * volume);
+        SetSoundPan( voice->sound, 1.0f - (position.x / world.width) / 2.0f);
+        PlaySound( voice->sound);
+        voice->gain = gain;
+        voice->startTime = time;
+    }
+}
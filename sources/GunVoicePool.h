@@ -0,0 +1,67 @@
+#ifndef GUN_VOICE_POOL_H
+#define GUN_VOICE_POOL_H
+
+#include "GameEvent.h"
+#include "Listeners.h"
+#include "raylib.h"
+#include "WorldBounds.h"
+
+#include <array>
+#include <cstddef>
+#include <span>
+
+/**
+ * Plays the gun shots of all planes through a fixed number of voices.
+ *
+ * The gun sound is loaded once and each voice is an alias of it, which
+ * shares the sound data but plays on its own, so overlapping shots no longer
+ * cut each other off.
+ *
+ * Shots are played a frame at a time. Of the shots of a frame, only the
+ * loudest maxVoices can be heard. A shot takes a free voice if there is one,
+ * and otherwise steals the voice with the lowest priority if that is lower
+ * than its own. The priority of a playing voice is its volume times the part
+ * of the sound that is still to come, so shots that are far away or almost
+ * over give way first. However many planes fire, no more than maxVoices shots
+ * play at once.
+ */
+class GunVoicePool
+{
+public:
+    static constexpr std::size_t maxVoices = 8;
+
+    explicit GunVoicePool( const char *gunSoundPath);
+    ~GunVoicePool();
+
+    GunVoicePool( const GunVoicePool&) = delete;
+    GunVoicePool &operator=( const GunVoicePool&) = delete;
+
+    void SetVolume( float volume) { this->volume = volume; }
+
+    /// Play the shots among the events of a frame, at the given time in seconds.
+    void Play( std::span<const GameEvent> events, WorldBounds world, const Listeners &listeners, double time);
+
+private:
+    struct Shot
+    {
+        Vector2 position;
+        float   gain;
+    };
+
+    struct Voice
+    {
+        Sound   sound;
+        float   gain = 0.0f;
+        double  startTime = 0.0;
+    };
+
+    float GetPriority( const Voice &voice, double time) const;
+
+    Sound                           sound;
+    float                           duration;   ///< of the sound, in seconds
+    float                           volume = 1.0f;
+    std::array< Voice, maxVoices>   voices;
+    std::array< Shot, maxVoices>    shots;      ///< the loudest shots of the frame that is being played
+};
+
+#endif // GUN_VOICE_POOL_H
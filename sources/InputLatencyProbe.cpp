@@ -0,0 +1,164 @@
+#include "InputLatencyProbe.h"
+#include "Plane.h"
+#include "raylib.h"
+
+namespace {
+    constexpr double millisecondsPerSecond = 1000.0;
+
+    double SecondsBetween( InputLatencyProbe::Clock::time_point start, InputLatencyProbe::Clock::time_point end)
+    {
+        return std::chrono::duration<double>( end - start).count();
+    }
+
+    int Sign( int value)
+    {
+        return (value > 0) - (value < 0);
+    }
+}
+
+InputLatencyProbe::InputLatencyProbe( const char *csvPath)
+{
+    if (not csvPath)
+    {
+        return;
+    }
+
+    csv = std::fopen( csvPath, "w");
+    if (not csv)
+    {
+        TraceLog( LOG_ERROR, "LATENCY: cannot open %s for writing", csvPath);
+        return;
+    }
+    std::fprintf( csv, "frame,tick,player,turn,tick_us,present_us,total_us\n");
+}
+
+InputLatencyProbe::~InputLatencyProbe()
+{
+    if (csv)
+    {
+        std::fclose( csv);
+    }
+}
+
+void InputLatencyProbe::SampleInput( std::size_t player, std::int8_t turn, Angle65536 pitch, Clock::time_point sampleTime)
+{
+    if (player >= maxPlayers or turn == turns[player])
+    {
+        return;
+    }
+
+    turns[player] = turn;
+    auto &edge = edges[player];
+    edge.sampleTime = sampleTime;
+    edge.pitch = pitch;
+    edge.turn = turn;
+    edge.sampled = true;
+    edge.ticked = false;
+}
+
+void InputLatencyProbe::EndTick( std::size_t player, std::uint64_t tick, const Plane &plane)
+{
+    if (player >= maxPlayers)
+    {
+        return;
+    }
+    auto &edge = edges[player];
+    if (not edge.sampled or edge.ticked)
+    {
+        return;
+    }
+
+    // The plane shows the edge when it turns the way that it was asked to
+    // over the tick, or stops turning.
+    const auto state = plane.GetState();
+    const bool flying = state == Plane::Flying or state == Plane::Newborn;
+    if (not flying or Sign( plane.GetFinePitch() - edge.pitch) != edge.turn)
+    {
+        edge.sampled = false;
+        ++unseen;
+        return;
+    }
+    edge.tick = tick;
+    edge.tickEnd = Clock::now();
+    edge.ticked = true;
+}
+
+void InputLatencyProbe::EndFrame( Clock::time_point presentTime)
+{
+    for (std::size_t player = 0; player < maxPlayers; ++player)
+    {
+        auto &edge = edges[player];
+        if (not edge.ticked)
+        {
+            continue;
+        }
+
+        const double tickLatency = SecondsBetween( edge.sampleTime, edge.tickEnd);
+        const double presentLatency = SecondsBetween( edge.tickEnd, presentTime);
+        const double total = SecondsBetween( edge.sampleTime, presentTime);
+        histograms[Tick].Record( tickLatency);
+        histograms[Present].Record( presentLatency);
+        histograms[Total].Record( total);
+        if (csv)
+        {
+            std::fprintf(
+                csv, "%llu,%llu,%zu,%d,%.1f,%.1f,%.1f\n",
+                static_cast<unsigned long long>( frame),
+                static_cast<unsigned long long>( edge.tick),
+                player,
+                edge.turn,
+                tickLatency * 1e6,
+                presentLatency * 1e6,
+                total * 1e6);
+        }
+        edge.sampled = false;
+        edge.ticked = false;
+    }
+    ++frame;
+}
+
+void InputLatencyProbe::Reset()
+{
+    for (auto &histogram : histograms)
+    {
+        histogram.Reset();
+    }
+    unseen = 0;
+}
+
+const char *GetStageName( InputLatencyProbe::Stage stage)
+{
+    switch (stage)
+    {
+        case InputLatencyProbe::Tick:       return "tick";
+        case InputLatencyProbe::Present:    return "present";
+        case InputLatencyProbe::Total:      return "total";
+        case InputLatencyProbe::StageCount: break;
+    }
+    return "unknown";
+}
+
+const char *FormatInputLatency( const InputLatencyProbe &probe)
+{
+    static std::array<char, 1024> buffer;
+
+    int length = std::snprintf( buffer.data(), buffer.size(), "{\"unseenEdges\":%zu", probe.GetUnseenCount());
+    for (int stage = 0; stage < InputLatencyProbe::StageCount and length < static_cast<int>( buffer.size()); ++stage)
+    {
+        const auto &histogram = probe.GetHistogram( static_cast<InputLatencyProbe::Stage>( stage));
+        length += std::snprintf(
+            buffer.data() + length, buffer.size() - length,
+            ",\"%s\":{\"count\":%zu,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+            GetStageName( static_cast<InputLatencyProbe::Stage>( stage)),
+            histogram.GetCount(),
+            histogram.GetPercentile( 50) * millisecondsPerSecond,
+            histogram.GetPercentile( 95) * millisecondsPerSecond,
+            histogram.GetPercentile( 99) * millisecondsPerSecond,
+            histogram.GetMax() * millisecondsPerSecond);
+    }
+    if (length < static_cast<int>( buffer.size()))
+    {
+        std::snprintf( buffer.data() + length, buffer.size() - length, "}");
+    }
+    return buffer.data();
+}
@@ -0,0 +1,104 @@
+#ifndef INPUT_LATENCY_PROBE_H
+#define INPUT_LATENCY_PROBE_H
+
+#include "Angle65536.h"
+#include "FrameTelemetry.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+class Plane;
+
+/**
+ * Measures the time from an input edge, a player starting, stopping or
+ * reversing a turn, to the present of the first frame in which the plane
+ * turns accordingly.
+ *
+ * Every edge is timestamped with the time that the input was sampled, which
+ * FramePacer reports. The tick that consumes it is tagged when the pitch of
+ * the plane over that tick shows the effect of the new input, and the frame
+ * that is presented after that tick completes the measurement. Edges of
+ * which the plane shows no effect, because it is crashing or respawning, are
+ * counted but not measured.
+ *
+ * The latency of each edge is split into two stages: from the input sample to
+ * the end of the tick, which includes waiting for the simulation to get to
+ * the input, and from the end of the tick to the present, which includes
+ * drawing and waiting for the vsync. Optionally, every measured edge is also
+ * written to a CSV file.
+ */
+class InputLatencyProbe
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Stage
+    {
+        Tick,       ///< input sample to the end of the tick that consumed the edge
+        Present,    ///< end of that tick to the present of the frame that shows it
+        Total,
+        StageCount
+    };
+
+    static constexpr std::size_t maxPlayers = 2;
+
+    /// Without a CSV path, only the distributions are kept.
+    explicit InputLatencyProbe( const char *csvPath = nullptr);
+    ~InputLatencyProbe();
+
+    InputLatencyProbe( const InputLatencyProbe&) = delete;
+    InputLatencyProbe &operator=( const InputLatencyProbe&) = delete;
+
+    /**
+     * Note the turn that a player asks for in a tick, before the simulation
+     * applies it, with the pitch of the plane before the tick and the time
+     * at which the input was sampled.
+     */
+    void SampleInput( std::size_t player, std::int8_t turn, Angle65536 pitch, Clock::time_point sampleTime);
+
+    /// After the tick, see whether the plane of the player shows the effect of an edge that it sampled.
+    void EndTick( std::size_t player, std::uint64_t tick, const Plane &plane);
+
+    /// The frame has been presented at the given time.
+    void EndFrame( Clock::time_point presentTime);
+
+    void Reset();
+
+    const DurationHistogram &GetHistogram( Stage stage) const { return histograms[stage]; }
+
+    /// Edges of which the plane showed no effect in the tick that sampled them.
+    std::size_t GetUnseenCount() const { return unseen; }
+
+private:
+    struct Edge
+    {
+        Clock::time_point   sampleTime;
+        Clock::time_point   tickEnd;
+        std::uint64_t       tick = 0;
+        Angle65536          pitch;      ///< before the tick that sampled the edge
+        std::int8_t         turn = 0;   ///< after the edge
+        bool                sampled = false;
+        bool                ticked = false;
+    };
+
+    std::array<Edge, maxPlayers>        edges;
+    std::array<std::int8_t, maxPlayers> turns = {};
+    std::array<DurationHistogram, StageCount> histograms;
+    std::size_t     unseen = 0;
+    std::uint64_t   frame = 0;
+    std::FILE       *csv = nullptr;
+};
+
+const char *GetStageName( InputLatencyProbe::Stage stage);
+
+/**
+ * Format the latency distributions as a JSON object.
+ *
+ * The result is stored in a static buffer that is overwritten by the next call.
+ */
+const char *FormatInputLatency( const InputLatencyProbe &probe);
+
+#endif // INPUT_LATENCY_PROBE_H
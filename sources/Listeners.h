@@ -0,0 +1,36 @@
+#ifndef LISTENERS_H
+#define LISTENERS_H
+
+#include "DrawingUtilities.h"
+#include "raylib.h"
+#include "WorldBounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <span>
+
+/**
+ * The points in the world that the players hear from, one in the middle of
+ * each view, and how far they hear.
+ */
+struct Listeners
+{
+    std::span<const Vector2> positions;
+    float hearingDistance;  ///< sounds this close to a listener play at full volume, fading out to silence at twice the distance
+};
+
+/// How loud a sound at the given position is for the nearest listener, from 0 to 1.
+inline float GetGain( const Listeners &listeners, Vector2 position, WorldBounds world)
+{
+    float distance = std::numeric_limits<float>::infinity();
+    for (const auto &listener : listeners.positions)
+    {
+        distance = std::min( distance, std::hypot(
+            WrapDifference( position.x - listener.x, static_cast<float>( world.width)),
+            WrapDifference( position.y - listener.y, static_cast<float>( world.height))));
+    }
+    return std::clamp( 2.0f - distance / listeners.hearingDistance, 0.0f, 1.0f);
+}
+
+#endif // LISTENERS_H
@@ -0,0 +1,40 @@
+#include "MatchArena.h"
+
+#include <algorithm>
+
+MatchArena::MatchArena( std::size_t capacity)
+    : capacity( std::max<std::size_t>( capacity, 1)),
+    buffer( std::make_unique<std::byte[]>( this->capacity))
+{
+    resource.emplace( buffer.get(), this->capacity, &overflow);
+}
+
+void *MatchArena::do_allocate( std::size_t bytes, std::size_t alignment)
+{
+    used += bytes;
+    return resource->allocate( bytes, alignment);
+}
+
+void MatchArena::Reset()
+{
+    // Whether the match fit depends on alignment padding too, so rather than
+    // comparing what was asked for with the capacity, look at whether the
+    // buffer overflowed to the heap.
+    if (overflow.GetBytes() == 0)
+    {
+        // Start over at the beginning of the buffer.
+        resource->release();
+    }
+    else
+    {
+        // The match did not fit. Everything that it used fit in the buffer
+        // and the chunks from the heap together, so that makes room for the
+        // next one.
+        capacity += overflow.GetBytes();
+        resource.reset();
+        buffer = std::make_unique<std::byte[]>( capacity);
+        resource.emplace( buffer.get(), capacity, &overflow);
+    }
+    overflow.ResetBytes();
+    used = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef MATCH_ARENA_H
+#define MATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+/**
+ * The memory of everything that lives for a single match, for instance a
+ * Simulation and its containers, carved from one buffer.
+ *
+ * Allocating bumps a pointer and freeing does nothing, so a match never
+ * fragments the heap and threads that run matches of their own never contend
+ * for the allocator. At the end of the match, once everything that used the
+ * arena has been destroyed, Reset() takes the whole buffer back at once.
+ *
+ * Containers that outgrow the buffer continue in chunks from the heap. Those
+ * are returned by Reset(), which then grows the buffer by as much as the
+ * chunks held, so that the next matches fit. Freed memory is only reused after a
+ * reset, so containers should reserve what they need up front rather than
+ * grow step by step.
+ */
+class MatchArena : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t defaultCapacity = 256 * 1024;
+
+    explicit MatchArena( std::size_t capacity = defaultCapacity);
+
+    MatchArena( const MatchArena&) = delete;
+    MatchArena &operator=( const MatchArena&) = delete;
+
+    /// Bytes that were allocated since the last reset, including those that no longer are in use.
+    std::size_t GetUsedBytes() const { return used; }
+    std::size_t GetCapacity() const { return capacity; }
+
+    /// Bytes that the arena took from the heap since the last reset, because the buffer was full.
+    std::size_t GetOverflowBytes() const { return overflow.GetBytes(); }
+
+    /// Take back all memory. Nothing that was allocated from the arena may be used after this.
+    void Reset();
+
+private:
+    /// The heap, counting what the arena takes from it when the buffer is full.
+    class Overflow : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t GetBytes() const { return bytes; }
+        void ResetBytes() { bytes = 0; }
+
+    private:
+        void *do_allocate( std::size_t bytes, std::size_t alignment) override
+        {
+            this->bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate( bytes, alignment);
+        }
+        void do_deallocate( void *pointer, std::size_t bytes, std::size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate( pointer, bytes, alignment);
+        }
+        bool do_is_equal( const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+        std::size_t bytes = 0;
+    };
+
+    void *do_allocate( std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate( void*, std::size_t, std::size_t) override {}
+    bool do_is_equal( const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    std::size_t                                         capacity;
+    std::size_t                                         used = 0;
+    std::unique_ptr<std::byte[]>                        buffer;
+    Overflow                                            overflow;
+    std::optional<std::pmr::monotonic_buffer_resource>  resource;
+};
+
+#endif // MATCH_ARENA_H
@@ -0,0 +1,200 @@
+#include "ParticleSystem.h"
+
+#include "rlgl.h"
+#include "Viewport.h"
+
+#include <cmath>
+
+namespace { // unnamed
+
+    /// The soft round blob that every particle is drawn with.
+    Texture2D GetParticleTexture()
+    {
+        static const Texture2D texture = []{
+            Image image = GenImageGradientRadial( 16, 16, 0.0f, WHITE, BLANK);
+            const auto texture = LoadTextureFromImage( image);
+            UnloadImage( image);
+            return texture;
+        }();
+        return texture;
+    }
+}
+
+ParticleSystem::ParticleSystem( std::size_t capacity, std::pmr::memory_resource *resource)
+    : capacity( capacity),
+    x( capacity, resource),
+    y( capacity, resource),
+    speedX( capacity, resource),
+    speedY( capacity, resource),
+    age( capacity, resource),
+    lifeTime( capacity, resource),
+    size( capacity, resource),
+    growth( capacity, resource),
+    color( capacity, resource)
+{
+}
+
+void ParticleSystem::EmitMuzzleFlash( Vector2 position, Vector2 velocity)
+{
+    for (int particle = 0; particle < 3; ++particle)
+    {
+        Emit(
+            position,
+            { velocity.x * GetRandom( 0.3f, 0.6f), velocity.y * GetRandom( 0.3f, 0.6f)},
+            GetRandom( 0.05f, 0.1f), 6.0f, 40.0f, Color{ 255, 230, 120, 255});
+    }
+}
+
+void ParticleSystem::EmitExplosion( Vector2 position, Vector2 velocity)
+{
+    constexpr float twoPi = 6.2831853f;
+    for (int particle = 0; particle < 48; ++particle)
+    {
+        const float direction = GetRandom( 0.0f, twoPi);
+        const float speed = GetRandom( 20.0f, 160.0f);
+        const bool fire = particle % 3 == 0;
+        Emit(
+            position,
+            { velocity.x * 0.5f + std::cos( direction) * speed, velocity.y * 0.5f + std::sin( direction) * speed},
+            fire ? GetRandom( 0.2f, 0.5f) : GetRandom( 0.6f, 1.4f),
+            fire ? 10.0f : 8.0f,
+            fire ? 10.0f : 30.0f,
+            fire ? Color{ 255, 140, 30, 255} : Color{ 60, 60, 60, 200});
+    }
+}
+
+void ParticleSystem::EmitSmoke( Vector2 position, float deltaTime)
+{
+    // Emit a whole number of particles, but on average the right amount.
+    const auto particles = static_cast<int>( smokeRate * deltaTime + GetRandom( 0.0f, 1.0f));
+    for (int particle = 0; particle < particles; ++particle)
+    {
+        Emit(
+            position,
+            { GetRandom( -10.0f, 10.0f), GetRandom( -30.0f, -10.0f)},
+            GetRandom( 0.8f, 1.6f), 6.0f, 16.0f, Color{ 80, 80, 80, 160});
+    }
+}
+
+void ParticleSystem::Update( const WorldBounds &world, float deltaTime)
+{
+    const float damping = std::pow( drag, deltaTime);
+    const float width = static_cast<float>( world.width);
+    const float height = static_cast<float>( world.height);
+
+    // Separate loops without branches over the attribute arrays, so that each
+    // of them can be vectorized.
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        x[index] += speedX[index] * deltaTime;
+        y[index] += speedY[index] * deltaTime;
+    }
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        x[index] += width * static_cast<float>( x[index] < 0.0f) - width * static_cast<float>( x[index] >= width);
+        y[index] += height * static_cast<float>( y[index] < 0.0f) - height * static_cast<float>( y[index] >= height);
+    }
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        speedX[index] *= damping;
+        speedY[index] *= damping;
+    }
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        age[index] += deltaTime;
+        size[index] += growth[index] * deltaTime;
+    }
+
+    // Remove the particles that have lived their lives.
+    for (std::size_t index = 0; index < count;)
+    {
+        if (age[index] >= lifeTime[index])
+        {
+            Remove( index);
+        }
+        else
+        {
+            ++index;
+        }
+    }
+}
+
+void ParticleSystem::Draw( const Viewport &viewport) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    rlSetTexture( GetParticleTexture().id);
+    rlBegin( RL_QUADS);
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        // Fade out over the life of the particle.
+        const auto &tint = color[index];
+        const auto alpha = static_cast<unsigned char>( tint.a * (1.0f - age[index] / lifeTime[index]));
+        const float half = size[index] / 2.0f;
+        viewport.ForEachVisibleCopy( { x[index] - half, y[index] - half, size[index], size[index]}, [&]( Vector2 shift)
+        {
+            const float left = x[index] + shift.x - half;
+            const float right = x[index] + shift.x + half;
+            const float top = y[index] + shift.y - half;
+            const float bottom = y[index] + shift.y + half;
+
+            rlColor4ub( tint.r, tint.g, tint.b, alpha);
+            rlTexCoord2f( 0.0f, 0.0f);
+            rlVertex2f( left, top);
+            rlTexCoord2f( 0.0f, 1.0f);
+            rlVertex2f( left, bottom);
+            rlTexCoord2f( 1.0f, 1.0f);
+            rlVertex2f( right, bottom);
+            rlTexCoord2f( 1.0f, 0.0f);
+            rlVertex2f( right, top);
+        });
+    }
+    rlEnd();
+    rlSetTexture( 0);
+}
+
+void ParticleSystem::Emit( Vector2 position, Vector2 velocity, float lifeTime, float size, float growth, Color color)
+{
+    if (count == capacity)
+    {
+        return;
+    }
+
+    x[count] = position.x;
+    y[count] = position.y;
+    speedX[count] = velocity.x;
+    speedY[count] = velocity.y;
+    age[count] = 0.0f;
+    this->lifeTime[count] = lifeTime;
+    this->size[count] = size;
+    this->growth[count] = growth;
+    this->color[count] = color;
+    ++count;
+}
+
+void ParticleSystem::Remove( std::size_t index)
+{
+    const auto last = --count;
+    x[index] = x[last];
+    y[index] = y[last];
+    speedX[index] = speedX[last];
+    speedY[index] = speedY[last];
+    age[index] = age[last];
+    lifeTime[index] = lifeTime[last];
+    size[index] = size[last];
+    growth[index] = growth[last];
+    color[index] = color[last];
+}
+
+float ParticleSystem::GetRandom( float min, float max)
+{
+    // xorshift32, cheaper than raylib's GetRandomValue() and it does not
+    // disturb the random sequence that the rest of the game uses.
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return min + (max - min) * static_cast<float>( randomState >> 8) / static_cast<float>( 1u << 24);
+}
@@ -0,0 +1,75 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include "raylib.h"
+#include "WorldBounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+class Viewport;
+
+/**
+ * Smoke trails, explosions and muzzle flashes.
+ *
+ * The particles live in a pool with a fixed capacity that is allocated once.
+ * Each attribute is stored in an array of its own (structure of arrays), so
+ * that updating the particles comes down to a few straight loops over floats
+ * that the compiler can vectorize. Live particles are kept at the front of the
+ * arrays: a particle that dies is replaced by the last live particle. When the
+ * pool is full, new particles are dropped.
+ *
+ * All particles share one texture and are drawn as a single batch of quads,
+ * skipping the particles that are not in view.
+ */
+class ParticleSystem
+{
+public:
+    static constexpr std::size_t defaultCapacity = 32768;
+
+    explicit ParticleSystem(
+        std::size_t capacity = defaultCapacity,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /// A short flash at the muzzle of a gun that moves along with the bullet.
+    void EmitMuzzleFlash( Vector2 position, Vector2 velocity);
+
+    /// A burst of fire and smoke where a plane has been hit.
+    void EmitExplosion( Vector2 position, Vector2 velocity);
+
+    /// The trail of a crashing plane, about smokeRate particles per second.
+    void EmitSmoke( Vector2 position, float deltaTime);
+
+    void Update( const WorldBounds &world, float deltaTime);
+    void Draw( const Viewport &viewport) const;
+
+    std::size_t GetCount() const { return count; }
+    std::size_t GetCapacity() const { return capacity; }
+
+private:
+    static constexpr float smokeRate = 60.0f;
+    static constexpr float drag = 0.2f;     ///< fraction of the speed that is left after a second
+
+    void Emit( Vector2 position, Vector2 velocity, float lifeTime, float size, float growth, Color color);
+    void Remove( std::size_t index);
+    float GetRandom( float min, float max);
+
+    std::size_t         capacity;
+    std::size_t         count = 0;
+
+    std::pmr::vector<float> x;
+    std::pmr::vector<float> y;
+    std::pmr::vector<float> speedX;
+    std::pmr::vector<float> speedY;
+    std::pmr::vector<float> age;
+    std::pmr::vector<float> lifeTime;
+    std::pmr::vector<float> size;
+    std::pmr::vector<float> growth;     ///< change in size per second
+    std::pmr::vector<Color> color;
+
+    std::uint32_t       randomState = 0x2545f491;
+};
+
+#endif // PARTICLE_SYSTEM_H
@@ -1,22 +1,28 @@
 #include "Plane.h"
 
 #include "CloudSystem.h"
+#include "CommandBuffer.h"
 #include "DrawingUtilities.h"
 #include "GameWindow.h"
 #include "VectorMath.h"
+#include "WrapRenderer.h"
 
 
 #include "raylib.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <map>
 #include <sstream>
+#include <string>
 
 
 namespace {
     /**
      * Definition of a 'hit circle'.
-     * These circles are used to determine if the plane is hit by a bullet.
+     * These circles are used to determine if the plane is hit by a bullet
+     * when no collision masks could be loaded for the plane's skin.
      * Each plane has a set of hit circles that roughly correspond to the
      * plane's shape.
      */
@@ -34,11 +40,13 @@ namespace {
         {{ -18.0f, 0.0f}, 8.0f, 64.0f},
         {{ -35.0f, 0.0f}, 8.0f, 64.0f}
     }};
+    static_assert( hitCircles.size() == Plane::hitCircleCount);
 
-    // Calculates the squared distance between two Vector2 points.
-    float Vector2DistanceSquared(Vector2 v1, Vector2 v2)
+    std::string GetSkinFileName( std::string_view skin, int frame)
     {
-        return (v1.x - v2.x) * (v1.x - v2.x) + (v1.y - v2.y) * (v1.y - v2.y);
+        std::ostringstream oss;
+        oss << ASSETS_PATH << skin << std::setw(4) << std::setfill('0') << frame << ".png";
+        return oss.str();
     }
 
     struct DebugSettings
@@ -77,54 +85,75 @@ void DrawPlaneDebugIndicators( bool doDraw)
     debugSettings.drawDiagnostics = doDraw;
 }
 
+bool IsDrawingPlaneDebugIndicators()
+{
+    return debugSettings.drawDiagnostics;
+}
+
 Plane::Plane(
     int id,
     std::string_view skin,
     Color color,
     Vector2 position,
     float speed,
-    Angle256 pitch)
-    : id(id),color(color),position(position), speed(speed), pitch(pitch), bulletTexture( CreateBulletTexture( color, static_cast<int>(maxBullets)))
+    Angle65536 pitch)
+    : id(id),color(color),position(position), speed(speed), pitch(pitch),
+    bulletTexture( IsWindowReady() ? CreateBulletTexture( color, maxBullets) : RenderTexture2D{})
 {
-    textures = LoadPlaneTextures( skin);
-
-    // Create the bullet texture
-    constexpr auto bulletCircleRadius = 8.0f;
-    constexpr auto bulletCircleDistance = 2.0f;
-    auto bulletTextureWidth = static_cast<int>(maxBullets * (2 * bulletCircleRadius + bulletCircleDistance) - bulletCircleDistance);
-    auto bulletTexture = LoadRenderTexture(bulletTextureWidth, static_cast<int>(2 * bulletCircleRadius));
-
-    // Begin drawing to the render texture
-    BeginTextureMode(bulletTexture);
-    ClearBackground(BLANK);
-
-    for (int i = 0; i < maxBullets; ++i)
+    // Without a window there is no graphics context to load textures into.
+    // This happens when the world is simulated headless.
+    if (IsWindowReady())
     {
-        float x = i * (2 * bulletCircleRadius + bulletCircleDistance) + bulletCircleRadius;
-        float y = bulletCircleRadius;
-        DrawCircle(static_cast<int>(x), static_cast<int>(y), bulletCircleRadius, color);
+        textures = LoadPlaneTextures( skin);
     }
 
-    // End drawing to the render texture
-    EndTextureMode();
+    // The collision masks do not need a graphics context.
+    collisionMasks = &GetCollisionMasks( skin);
+    RotateHitCircles( cos( pitch), sin( pitch));
 }
 
-void Plane::Reset( Vector2 position, float speed, Angle256 pitch)
+void Plane::Reset( Vector2 position, float speed, Angle65536 pitch)
 {
     this->position = position;
     this->speed = speed;
     this->pitch = pitch;
     this->roll = 0;
     this->state = Newborn;
-    timer = 2.0f;
+    displacement = { 0, 0 };
+    ++generation;
+    RotateHitCircles( cos( pitch), sin( pitch));
+}
+
+Plane::Snapshot Plane::GetSnapshot() const
+{
+    return {
+        position, speedVector, displacement, speed, pitch, roll, state, generation,
+        loadedBullets, reloading, reloadDue, inCloud};
+}
+
+void Plane::Restore( const Snapshot &snapshot)
+{
+    position = snapshot.position;
+    speedVector = snapshot.speedVector;
+    displacement = snapshot.displacement;
+    speed = snapshot.speed;
+    pitch = snapshot.pitch;
+    roll = snapshot.roll;
+    state = snapshot.state;
+    generation = snapshot.generation;
+    loadedBullets = snapshot.loadedBullets;
+    reloading = snapshot.reloading;
+    reloadDue = snapshot.reloadDue;
+    inCloud = snapshot.inCloud;
+    RotateHitCircles( cos( pitch), sin( pitch));
 }
 
-bool Plane::Fire( Bullets &bullets)
+bool Plane::Fire( CommandBuffer &commands)
 {
-    if (state == Flying and bulletCount >= 1.0f)
+    if (state == Flying and loadedBullets > 0)
     {
-        bulletCount -= 1.0f;
-        bullets.emplace_back( color, id, position, speedVector * 2.0f);
+        --loadedBullets;
+        commands.SpawnBullet( color, id, position, speedVector * 2.0f);
         return true;
     }
     else
@@ -133,9 +162,9 @@ bool Plane::Fire( Bullets &bullets)
     }
 }
 
-Angle256 Plane::DeltaPitch(std::int8_t angle)
+Angle65536 Plane::DeltaPitch( std::int32_t units)
 {
-    return this->pitch += angle;
+    return pitch += units;
 }
 
 Angle256 Plane::DeltaRoll(std::int8_t angle)
@@ -143,7 +172,50 @@ Angle256 Plane::DeltaRoll(std::int8_t angle)
     return this->roll += angle;
 }
 
-void Plane::Draw( const GameWindow &window) const
+void Plane::RollToUpright()
+{
+    static constexpr std::int8_t rollCorrection = 4;
+    if (GetPitch() >= 64 and GetPitch() < 192)
+    {
+        if (roll != 128)
+        {
+            DeltaRoll(roll > 128 ? -rollCorrection : rollCorrection);
+        }
+    }
+    else
+    {
+        if (roll != 0)
+        {
+            DeltaRoll(roll >= 128 ? +rollCorrection : -rollCorrection);
+        }
+    }
+}
+
+void Plane::Steer( const PlaneInput &input, float deltaTime, CommandBuffer &commands)
+{
+    // Turning is as fine as an Angle65536, so it takes as long at any frame rate.
+    const auto turn = static_cast<std::int32_t>( std::lround( turnRate * deltaTime));
+    if (input.turn > 0)
+    {
+        DeltaPitch( turn);
+    }
+    else if (input.turn < 0)
+    {
+        DeltaPitch( -turn);
+    }
+
+    if ((input.turn == 0 or (roll != 0 and roll != 128)) and state != Crashing)
+    {
+        RollToUpright();
+    }
+
+    if (input.fire)
+    {
+        Fire( commands);
+    }
+}
+
+void Plane::Draw( WrapRenderer &renderer) const
 {
 
     if (state == Crashed)
@@ -151,75 +223,107 @@ void Plane::Draw( const GameWindow &window) const
         return;
     }
 
-    // Draw the plane texture with wrapping.
-    DrawWrapped(window, textures.at(roll/16), position, positionOffset, pitch, state == Newborn? Fade( WHITE, 0.5f):WHITE, state == Crashing);
+    // Draw the plane texture with wrapping, except for planes that crash
+    // through the bottom of the world.
+    renderer.AddSprite(textures.at(roll/16), position, positionOffset, pitch, state == Newborn? Fade( WHITE, 0.5f):WHITE, state != Crashing);
 
     if (debugSettings.drawDiagnostics)
     {
         // Draw a circle at the plane position.
         DrawCircleLinesV( position, 20, PURPLE);
 
-        // Draw the hit circles.
-        for (const auto& circle : hitCircles)
+        // Draw the bounding box, and the hit circles if they are in use.
+        const auto box = GetBoundingBox();
+        DrawRectangleLines(
+            static_cast<int>( box.x), static_cast<int>( box.y),
+            static_cast<int>( box.width), static_cast<int>( box.height), BLACK);
+        if ((*collisionMasks)[roll/16].IsEmpty())
         {
-            Vector2 scaledPosition = position + Rotate( circle.position, pitch);
-            DrawCircleLinesV(scaledPosition, std::sqrt( circle.radiusSquared), BLACK);
+            for (std::size_t index = 0; index < hitCircles.size(); ++index)
+            {
+                DrawCircleLinesV( position + hitCircleCenters[index], hitCircles[index].radius, BLACK);
+            }
         }
     }
 }
 
-void Plane::Update( const GameWindow &window, float deltaTime)
+void Plane::Update( const WorldBounds &world, float deltaTime)
+{
+    UpdatePitch( world, deltaTime);
+    Move( world, deltaTime, cos( pitch), sin( pitch));
+}
+
+void Plane::UpdatePitch( const WorldBounds &world, float deltaTime)
 {
     // do nothing if we (crashed) offscreen
-    if (state == Crashed or (state == Crashing and position.y > window.height + positionOffset.y))
+    if (state == Crashed or (state == Crashing and position.y > world.height + positionOffset.y))
     {
         state = Crashed;
-        return;
+        displacement = { 0, 0 };
     }
     else if (state == Crashing)
     {
         DeltaRoll( 4);
-        if (pitch >= 192 or pitch < 32)
+        const auto turn = static_cast<std::int32_t>( std::lround( turnRate * deltaTime));
+        if (GetPitch() >= 192 or GetPitch() < 32)
         {
-            DeltaPitch( 120.0 * deltaTime + 0.5f);
+            DeltaPitch( turn);
         }
-        else if (pitch >= 96)
+        else if (GetPitch() >= 96)
         {
-            DeltaPitch(-120.0 * deltaTime - 0.5f);
+            DeltaPitch( -turn);
         }
     }
+}
 
-    if (state == Newborn)
+void Plane::Move( const WorldBounds &world, float deltaTime, float cosine, float sine)
+{
+    if (state == Crashed)
     {
-        timer -= deltaTime;
-        if (timer <= 0.0f)
-        {
-            state = Flying;
-            timer = 0.0f;
-        }
+        return;
     }
 
+    RotateHitCircles( cosine, sine);
     speedVector = Vector2{
-        cos(pitch) * speed,
-        sin(pitch) * speed};
-    position += speedVector * deltaTime;
+        cosine * speed,
+        sine * speed};
+    displacement = speedVector * deltaTime;
+    position += displacement;
 
     // Wrap around the screen edges, except when we are crashing.
     if (state == Flying or state == Newborn)
     {
         position = {
-            Wrap(position.x, static_cast<float>(window.width)),
-            Wrap(position.y, static_cast<float>(window.height))};
+            Wrap(position.x, static_cast<float>(world.width)),
+            Wrap(position.y, static_cast<float>(world.height))};
     }
+}
 
-    if (bulletCount < maxBullets)
+void Plane::RotateHitCircles( float cosine, float sine)
+{
+    for (std::size_t index = 0; index < hitCircles.size(); ++index)
     {
-        bulletCount += 0.75f * deltaTime;
-        if (bulletCount > maxBullets)
-        {
-            bulletCount = maxBullets;
-        }
+        const auto &circle = hitCircles[index].position;
+        hitCircleCenters[index] = {
+            circle.x * cosine - circle.y * sine,
+            circle.x * sine + circle.y * cosine};
+    }
+}
+
+void Plane::FinishReload()
+{
+    reloading = false;
+    loadedBullets = std::min( loadedBullets + 1, maxBullets);
+}
+
+float Plane::GetBulletCount( double time) const
+{
+    if (not reloading)
+    {
+        return static_cast<float>( loadedBullets);
     }
+    const auto progress = 1.0 - (reloadDue - time) / reloadTime;
+    return loadedBullets + static_cast<float>( std::clamp( progress, 0.0, 1.0));
 }
 
 Plane::PlaneTextures Plane::LoadPlaneTextures( std::string_view skin)
@@ -228,36 +332,113 @@ Plane::PlaneTextures Plane::LoadPlaneTextures( std::string_view skin)
 
     for (int i = 0; i < textures.size(); ++i)
     {
-        std::ostringstream oss;
-        oss << ASSETS_PATH << skin << std::setw(4) << std::setfill('0') << i << ".png";
-        textures[i] = LoadTexture(oss.str().c_str());
+        textures[i] = LoadTexture( GetSkinFileName( skin, i).c_str());
     }
 
-    positionOffset = {
-        static_cast<float>(textures[0].width) / 2.0f,
-        static_cast<float>(textures[0].height) / 2.0f};
+    size = {
+        static_cast<float>(textures[0].width),
+        static_cast<float>(textures[0].height)};
+    positionOffset = { size.x / 2.0f, size.y / 2.0f };
 
     return textures;
 }
 
+/**
+ * Get the collision masks of the given skin, one for each roll frame.
+ *
+ * Masks are created from the alpha channel of the skin images the first time
+ * they are needed and then shared by all planes with that skin. If the images
+ * cannot be loaded, the masks are empty.
+ */
+const Plane::PlaneCollisionMasks &Plane::GetCollisionMasks( std::string_view skin)
+{
+    static std::map<std::string, PlaneCollisionMasks, std::less<>> masksPerSkin;
+
+    if (const auto found = masksPerSkin.find( skin); found != masksPerSkin.end())
+    {
+        return found->second;
+    }
+
+    PlaneCollisionMasks masks;
+    for (std::size_t i = 0; i < masks.size(); ++i)
+    {
+        const auto image = LoadImage( GetSkinFileName( skin, static_cast<int>( i)).c_str());
+        masks[i] = CollisionMask( image);
+        UnloadImage( image);
+    }
+    return masksPerSkin.emplace( skin, std::move( masks)).first->second;
+}
+
 Rectangle Plane::GetBoundingBox() const
 {
     return {
         position.x - positionOffset.x,
         position.y - positionOffset.y,
-        static_cast<float>(textures[0].width),
-        static_cast<float>(textures[0].height)};
+        size.x,
+        size.y};
 }
 
-bool Plane::Collides( Vector2 point) const
+bool Plane::Collides( const Transform &transform, Vector2 point, Vector2 pointDisplacement, const WorldBounds &world) const
 {
+    const auto &[position, displacement, pitch, roll, state, generation] = transform;
+
     // we can't be hit if we're crashing, or newborn.
     if (state == Flying)
     {
-        for (const auto& circle : hitCircles)
+        // Work in the frame of reference of the plane, in which the point moved
+        // from 'start' to 'end' during the last update. Taking the shortest
+        // wrapped difference makes this work across the edges of the world.
+        const Vector2 end = {
+            WrapDifference( point.x - position.x, static_cast<float>( world.width)),
+            WrapDifference( point.y - position.y, static_cast<float>( world.height))};
+        const Vector2 start = end - (pointDisplacement - displacement);
+
+        // Test against the mask of the roll frame, by rotating the segment
+        // back into the unrotated pixel coordinates of the sprite.
+        if (const auto& mask = (*collisionMasks)[roll/16]; not mask.IsEmpty())
+        {
+            const auto unrotate = -pitch;
+            return mask.TestSegment(
+                Rotate( start, unrotate) + positionOffset,
+                Rotate( end, unrotate) + positionOffset);
+        }
+
+        // The rotated centers are cached for the current pitch, only a
+        // rewound transform needs them rotated here.
+        const bool current = pitch == this->pitch;
+        for (std::size_t index = 0; index < hitCircles.size(); ++index)
+        {
+            const auto &circle = hitCircles[index];
+            const Vector2 center = current ? hitCircleCenters[index] : Rotate( circle.position, pitch);
+            if (SegmentDistanceSquared( start, end, center) < circle.radiusSquared)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Plane::CollidesWith( const Plane &other, const WorldBounds &world) const
+{
+    // only planes that are flying can collide with each other.
+    if (state != Flying or other.state != Flying)
+    {
+        return false;
+    }
+
+    // Compare the hit circles of both planes, relative to this plane.
+    const Vector2 otherPosition = {
+        WrapDifference( other.position.x - position.x, static_cast<float>( world.width)),
+        WrapDifference( other.position.y - position.y, static_cast<float>( world.height))};
+    for (std::size_t index = 0; index < hitCircles.size(); ++index)
+    {
+        const Vector2 center = hitCircleCenters[index];
+        for (std::size_t otherIndex = 0; otherIndex < hitCircles.size(); ++otherIndex)
         {
-            Vector2 scaledPosition = position + Rotate( circle.position, pitch);
-            if (Vector2DistanceSquared(point, scaledPosition) < circle.radiusSquared)
+            const Vector2 otherCenter = otherPosition + other.hitCircleCenters[otherIndex];
+            const float distance = hitCircles[index].radius + hitCircles[otherIndex].radius;
+            if (Vector2DistanceSquared( center, otherCenter) < distance * distance)
             {
                 return true;
             }
@@ -2,14 +2,20 @@
 #define PLANE_H
 
 #include "Angle256.h"
+#include "Angle65536.h"
 #include "Bullet.h"
+#include "CollisionMask.h"
+#include "PlaneInput.h"
 #include "raylib.h"
+#include "WorldBounds.h"
 
 #include <array>
 #include <cstdint>
 #include <string_view>
 
+class CommandBuffer;
 struct GameWindow;
+class WrapRenderer;
 
 class Plane
 {
@@ -20,34 +26,121 @@ public:
         Crashed,
         Newborn
     };
+
+    /// Where a plane is, how it is turned and whether it can be hit, as kept in the transform history.
+    struct Transform
+    {
+        Vector2     position;
+        Vector2     displacement;   ///< distance travelled during the update that led here
+        Angle65536  pitch;
+        Angle256    roll;
+        State       state;
+        std::uint32_t generation;
+    };
+
+    /// Everything about a plane that changes while it flies, for the keyframes of replays.
+    struct Snapshot
+    {
+        Vector2         position;
+        Vector2         speedVector;
+        Vector2         displacement;
+        float           speed;
+        Angle65536      pitch;
+        Angle256        roll;
+        State           state;
+        std::uint32_t   generation;
+        int             loadedBullets;
+        bool            reloading;
+        double          reloadDue;
+        bool            inCloud;
+    };
+
+    constexpr static float newbornTime = 2.0f;      ///< seconds that a plane is Newborn after a reset
+    constexpr static float reloadTime = 4.0f / 3;   ///< seconds to reload a single bullet
+    constexpr static int maxBullets = 3;
+    constexpr static float turnRate = 120.0f * 256;  ///< Angle65536 units per second, for a pilot who turns
+    constexpr static std::size_t hitCircleCount = 4;
+
     Plane(
         int id,
         std::string_view skin,
         Color color,
         Vector2 position,
         float speed = 200,
-        Angle256 pitch = 0);
+        Angle65536 pitch = {});
 
-    void Reset( Vector2 position, float speed, Angle256 pitch);
+    /// Respawn the plane as Newborn, which starts a new generation.
+    void Reset( Vector2 position, float speed, Angle65536 pitch);
+    std::uint32_t GetGeneration() const { return generation; }
 
-    Angle256 DeltaPitch(std::int8_t angle);
+    /// Turn by the given number of Angle65536 units.
+    Angle65536 DeltaPitch( std::int32_t units);
     Angle256 DeltaRoll(std::int8_t angle);
+
+    /// Roll a step towards the upright position for the current pitch.
+    void RollToUpright();
+
+    /**
+     * Turn and fire as the pilot wants. A plane that does not turn, or that
+     * is halfway a roll, rolls towards the upright position.
+     */
+    void Steer( const PlaneInput &input, float deltaTime, CommandBuffer &commands);
     Angle256 GetRoll() const  { return roll; }
-    Angle256 GetPitch() const { return pitch; }
+    /// The pitch, rounded to the nearest Angle256.
+    Angle256 GetPitch() const { return pitch.ToAngle256(); }
+    Angle65536 GetFinePitch() const { return pitch; }
     Vector2 GetPosition() const { return position; }
     Vector2 GetSpeedVector() const { return speedVector; }
+    friend Vector2 GetDisplacement( const Plane &plane) { return plane.displacement; }
     float GetSpeed() const { return speed; }
     Color GetColor() const { return color; }
 
-    void Draw( const GameWindow &window) const;
-    void Update( const GameWindow &window, float deltaTime);
+    void Draw( WrapRenderer &renderer) const;
+    void Update( const WorldBounds &world, float deltaTime);
+
+    /**
+     * Update() in two parts, so that the owner can compute the sines and
+     * cosines of the pitches of many planes in one batch in between. First,
+     * a crashing plane spirals down, or stops once it has left the world.
+     */
+    void UpdatePitch( const WorldBounds &world, float deltaTime);
+
+    /// Then the plane flies on along its pitch, of which the cosine and sine are given.
+    void Move( const WorldBounds &world, float deltaTime, float cosine, float sine);
     Rectangle GetBoundingBox() const;
     void SetState( State state) { this->state = state; }
     State GetState() const { return state; }
-    bool Collides( Vector2 point) const;
-    bool Fire( Bullets &bullets);
-    void DrawBulletCount( const GameWindow &window, const Vector2 &position) const
+    Snapshot GetSnapshot() const;
+    void Restore( const Snapshot &snapshot);
+
+    Transform GetTransform() const { return { position, displacement, pitch, roll, state, generation}; }
+    bool Collides( Vector2 point, Vector2 displacement, const WorldBounds &world) const
+    {
+        return Collides( GetTransform(), point, displacement, world);
+    }
+
+    /// Test a moving point against this plane as it was at an earlier transform.
+    bool Collides( const Transform &transform, Vector2 point, Vector2 displacement, const WorldBounds &world) const;
+    bool CollidesWith( const Plane &other, const WorldBounds &world) const;
+    void SetInCloud( bool inCloud) { this->inCloud = inCloud; }
+    bool IsInCloud() const { return inCloud; }
+    /// Record a new bullet in the command buffer, if the plane can fire.
+    bool Fire( CommandBuffer &commands);
+
+    /**
+     * Reloading happens one bullet at a time. The simulation starts a reload
+     * whenever a plane is not fully loaded and schedules its end.
+     */
+    bool NeedsReload() const { return loadedBullets < maxBullets and not reloading; }
+    void StartReload( double due) { reloading = true; reloadDue = due; }
+    void FinishReload();
+
+    /// The number of loaded bullets plus the part of the current reload that is done at the given time.
+    float GetBulletCount( double time) const;
+
+    void DrawBulletCount( const GameWindow &window, const Vector2 &position, double time) const
     {
+        const float bulletCount = GetBulletCount( time);
         if (bulletCount > 0) {
             float width = bulletTexture.texture.width * (bulletCount / maxBullets);
             Rectangle sourceRec = { 0, 0, width, static_cast<float>(bulletTexture.texture.height) };
@@ -59,29 +152,42 @@ public:
 
 private:
     using PlaneTextures = std::array<Texture2D, 16>;
-    constexpr static float maxBullets = 3.0f;
+    using PlaneCollisionMasks = std::array<CollisionMask, 16>;
+
+    /// Size of the plane sprites, used when the textures are not loaded.
+    constexpr static Vector2 spriteSize = { 100.0f, 100.0f };
 
 
     std::size_t id;
     Vector2 position; ///< position of the midpoint of the plane
-    Vector2 positionOffset = { 0, 0 }; ///< offset of the midpoint relative to the plane texture
+    Vector2 positionOffset = { spriteSize.x / 2.0f, spriteSize.y / 2.0f }; ///< offset of the midpoint relative to the plane texture
 
     Color   color = PURPLE;
     float    speed = 200.0f;
-    Angle256 pitch = 0;
+    Angle65536 pitch;
     Angle256 roll = 0;
-    PlaneTextures textures;
+    std::array<Vector2, hitCircleCount> hitCircleCenters = {};    ///< relative to the position, rotated by the pitch
+    PlaneTextures textures = {};
+    const PlaneCollisionMasks *collisionMasks = nullptr; ///< shared by all planes with the same skin
+    Vector2 size = spriteSize; ///< size of the plane textures
     State state = Flying;
-    float timer = 0.0f; // used for automatic state transitions
-    float bulletCount = maxBullets;
+    std::uint32_t generation = 0;
+    int loadedBullets = maxBullets;
+    bool reloading = false;
+    double reloadDue = 0.0; ///< simulation time at which the current reload is done
+    bool inCloud = false;
 
     // this is a cached value, calculated from the pitch and speed.
     mutable Vector2 speedVector = { 0, 0 };
+    Vector2 displacement = { 0, 0 }; ///< distance travelled during the last update, before wrapping
     const RenderTexture2D bulletTexture;
 
+    void RotateHitCircles( float cosine, float sine);
     PlaneTextures LoadPlaneTextures( std::string_view skin);
+    static const PlaneCollisionMasks &GetCollisionMasks( std::string_view skin);
 };
 
 void DrawPlaneDebugIndicators( bool doDraw = true);
+bool IsDrawingPlaneDebugIndicators();
 
 #endif // PLANE_H
@@ -0,0 +1,19 @@
+#ifndef PLANE_INPUT_H
+#define PLANE_INPUT_H
+
+#include <cstdint>
+
+/**
+ * What the pilot of a plane wants it to do during a single tick.
+ *
+ * All sources of control, whether a keyboard, a computer pilot or a recording,
+ * come down to one of these per plane per tick. The simulation applies them
+ * all at once, so a control only decides and never touches the plane itself.
+ */
+struct PlaneInput
+{
+    std::int8_t turn = 0;   ///< -1 to turn left, +1 to turn right, 0 to fly straight on
+    bool        fire = false;
+};
+
+#endif // PLANE_INPUT_H
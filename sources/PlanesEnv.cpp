@@ -0,0 +1,347 @@
+#include "PlanesEnv.h"
+
+#include "DrawingUtilities.h"
+#include "MatchArena.h"
+#include "Simulation.h"
+#include "raylib.h"
+
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace { // unnamed
+
+    constexpr float tickTime = 1.0f / 60;
+
+    /**
+     * A single world of the environment, with what it needs to compute
+     * rewards. The simulation of each match lives in an arena of the world,
+     * so that worlds on different threads don't contend for the heap and
+     * starting a new match takes back all memory of the previous one at once.
+     */
+    struct World
+    {
+        explicit World( const PlanesEnvConfig &config)
+            : arena( std::make_unique<MatchArena>()),
+            inputs( config.planesPerWorld),
+            scores( config.planesPerWorld, 0)
+        {
+            StartMatch( config);
+        }
+
+        /// Start over with new planes at random positions and no scores.
+        void StartMatch( const PlanesEnvConfig &config)
+        {
+            simulation.reset();
+            arena->Reset();
+            simulation.emplace( WorldBounds{ config.worldWidth, config.worldHeight}, CloudSystem{}, 0, arena.get());
+            simulation->Reserve( config.planesPerWorld);
+            for (int plane = 0; plane < config.planesPerWorld; ++plane)
+            {
+                simulation->AddPlane(
+                    plane % 2 ? "red" : "green",
+                    plane % 2 ? RED : DARKGREEN,
+                    Vector2{
+                        static_cast<float>( GetRandomValue( 0, config.worldWidth - 1)),
+                        static_cast<float>( GetRandomValue( 0, config.worldHeight - 1))},
+                    220,
+                    static_cast<Angle256>( GetRandomValue( 0, 255)));
+            }
+            std::fill( scores.begin(), scores.end(), 0);
+        }
+
+        std::unique_ptr<MatchArena> arena;      ///< stays put when the world moves
+        std::optional<Simulation>   simulation;
+        std::vector<PlaneInput>     inputs;
+        std::vector<int>            scores;     ///< scores at the end of the previous tick
+    };
+
+    void Observe( const World &world, float *observations)
+    {
+        const auto &bounds = world.simulation->GetBounds();
+        const float width = static_cast<float>( bounds.width);
+        const float height = static_cast<float>( bounds.height);
+        const auto &planes = world.simulation->GetPlanes();
+        const auto &bullets = world.simulation->GetBullets();
+
+        for (std::size_t index = 0; index < planes.size(); ++index)
+        {
+            const auto &plane = planes[index];
+            const auto position = plane.GetPosition();
+            const auto GetOffset = [&]( Vector2 to) {
+                return Vector2{
+                    WrapDifference( to.x - position.x, width) / width,
+                    WrapDifference( to.y - position.y, height) / height};
+            };
+            const auto GetDistance = []( Vector2 offset) { return offset.x * offset.x + offset.y * offset.y; };
+
+            float *observation = observations + index * PLANES_ENV_OBSERVATION_SIZE;
+            std::fill( observation, observation + PLANES_ENV_OBSERVATION_SIZE, 0.0f);
+            observation[0] = position.x / width;
+            observation[1] = position.y / height;
+            observation[2] = cos( plane.GetFinePitch());
+            observation[3] = sin( plane.GetFinePitch());
+            observation[4] = plane.GetBulletCount( world.simulation->GetTime()) / Plane::maxBullets;
+            observation[5] = plane.GetState() == Plane::Flying ? 1.0f : 0.0f;
+
+            float nearest = std::numeric_limits<float>::max();
+            for (std::size_t other = 0; other < planes.size(); ++other)
+            {
+                if (other == index or planes[other].GetState() != Plane::Flying)
+                {
+                    continue;
+                }
+                const auto offset = GetOffset( planes[other].GetPosition());
+                if (GetDistance( offset) < nearest)
+                {
+                    nearest = GetDistance( offset);
+                    observation[6] = offset.x;
+                    observation[7] = offset.y;
+                    observation[8] = cos( planes[other].GetFinePitch());
+                    observation[9] = sin( planes[other].GetFinePitch());
+                    observation[10] = 1.0f;
+                }
+            }
+
+            nearest = std::numeric_limits<float>::max();
+            for (const auto &bullet : bullets)
+            {
+                if (static_cast<std::size_t>( bullet.GetOwner()) == index)
+                {
+                    continue;
+                }
+                const auto offset = GetOffset( GetPosition( bullet));
+                if (GetDistance( offset) < nearest)
+                {
+                    nearest = GetDistance( offset);
+                    observation[11] = offset.x;
+                    observation[12] = offset.y;
+                    observation[13] = 1.0f;
+                }
+            }
+        }
+    }
+}
+
+struct PlanesEnv
+{
+    PlanesEnv( const PlanesEnvConfig &config, int threadCount)
+        : config( config), start( threadCount), finish( threadCount)
+    {
+        SetRandomSeed( config.seed);
+        worlds.reserve( config.worldCount);
+        for (int world = 0; world < config.worldCount; ++world)
+        {
+            worlds.emplace_back( config);
+        }
+
+        // The calling thread steps the first range of worlds itself.
+        try
+        {
+            for (int thread = 1; thread < threadCount; ++thread)
+            {
+                workers.emplace_back( [this, thread]{ Work( thread); });
+            }
+        }
+        catch (...)
+        {
+            // The workers that did start wait for the others at the start
+            // barrier. Arrive for all that are missing and let them stop, as
+            // joinable threads must not be destroyed.
+            stopping = true;
+            static_cast<void>( start.arrive( threadCount - static_cast<std::ptrdiff_t>( workers.size())));
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+            throw;
+        }
+    }
+
+    ~PlanesEnv()
+    {
+        stopping = true;
+        start.arrive_and_wait();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    int GetThreadCount() const { return static_cast<int>( workers.size()) + 1; }
+
+    void Work( int thread)
+    {
+        for (;;)
+        {
+            start.arrive_and_wait();
+            if (stopping)
+            {
+                return;
+            }
+            StepWorlds( thread);
+            finish.arrive_and_wait();
+        }
+    }
+
+    void Step( const PlanesEnvAction *actions, float *observations, float *rewards, std::uint8_t *dones)
+    {
+        // The barriers make the arguments visible to the workers and their
+        // results visible to the caller.
+        this->actions = actions;
+        this->observations = observations;
+        this->rewards = rewards;
+        this->dones = dones;
+        start.arrive_and_wait();
+        StepWorlds( 0);
+        finish.arrive_and_wait();
+    }
+
+    /// Step the worlds of a thread, a contiguous range so that threads don't share cache lines.
+    void StepWorlds( int thread)
+    {
+        const auto threadCount = static_cast<std::size_t>( GetThreadCount());
+        const auto begin = worlds.size() * thread / threadCount;
+        const auto end = worlds.size() * (thread + 1) / threadCount;
+        for (auto index = begin; index < end; ++index)
+        {
+            StepWorld( index);
+        }
+    }
+
+    void StepWorld( std::size_t index)
+    {
+        auto &world = worlds[index];
+        auto &simulation = *world.simulation;
+        const auto first = index * config.planesPerWorld;
+        for (std::size_t plane = 0; plane < world.inputs.size(); ++plane)
+        {
+            const auto &action = actions[first + plane];
+            world.inputs[plane] = { static_cast<std::int8_t>( std::clamp<int>( action.turn, -1, 1)), action.fire != 0};
+            rewards[first + plane] = 0.0f;
+            dones[first + plane] = 0;
+        }
+
+        for (int tick = 0; tick < config.ticksPerStep; ++tick)
+        {
+            simulation.Tick( world.inputs, tickTime);
+
+            for (const auto &event : simulation.GetEvents())
+            {
+                if (event.kind == GameEvent::PlaneDown)
+                {
+                    rewards[first + event.plane] -= 1.0f;
+                    dones[first + event.plane] = 1;
+                }
+            }
+            for (std::size_t plane = 0; plane < world.scores.size(); ++plane)
+            {
+                const int score = simulation.GetScore( plane);
+                rewards[first + plane] += static_cast<float>( score - world.scores[plane]);
+                world.scores[plane] = score;
+            }
+        }
+
+        Observe( world, observations + first * PLANES_ENV_OBSERVATION_SIZE);
+    }
+
+    PlanesEnvConfig             config;
+    std::vector<World>          worlds;
+    std::vector<std::thread>    workers;
+    std::barrier<>              start;
+    std::barrier<>              finish;
+    bool                        stopping = false;
+
+    // The arguments of the current step.
+    const PlanesEnvAction      *actions = nullptr;
+    float                      *observations = nullptr;
+    float                      *rewards = nullptr;
+    std::uint8_t               *dones = nullptr;
+};
+
+PlanesEnvConfig PlanesEnvGetDefaultConfig( void)
+{
+    return { 1, 2, 1024, 768, 1, 0, 1};
+}
+
+PlanesEnv *PlanesEnvCreate( const PlanesEnvConfig *config)
+{
+    if (not config
+        or config->worldCount <= 0
+        or config->planesPerWorld <= 0
+        or config->worldWidth <= 0
+        or config->worldHeight <= 0
+        or config->ticksPerStep <= 0
+        or config->threadCount < 0)
+    {
+        TraceLog( LOG_ERROR, "ENV: invalid configuration");
+        return nullptr;
+    }
+
+    const int hardwareThreads = static_cast<int>( std::max( 1u, std::thread::hardware_concurrency()));
+    const int threadCount = std::min( config->threadCount ? config->threadCount : hardwareThreads, config->worldCount);
+    try
+    {
+        auto *env = new PlanesEnv( *config, threadCount);
+        TraceLog(
+            LOG_INFO, "ENV: %d worlds with %d planes each on %d threads",
+            config->worldCount, config->planesPerWorld, threadCount);
+        return env;
+    }
+    catch (const std::exception &exception)
+    {
+        // Exceptions must not cross the C interface.
+        TraceLog( LOG_ERROR, "ENV: could not create the environment: %s", exception.what());
+        return nullptr;
+    }
+}
+
+void PlanesEnvDestroy( PlanesEnv *env)
+{
+    delete env;
+}
+
+int PlanesEnvGetPlaneCount( const PlanesEnv *env)
+{
+    return env->config.worldCount * env->config.planesPerWorld;
+}
+
+void PlanesEnvObserve( const PlanesEnv *env, float *observations)
+{
+    for (std::size_t index = 0; index < env->worlds.size(); ++index)
+    {
+        Observe( env->worlds[index], observations + index * env->config.planesPerWorld * PLANES_ENV_OBSERVATION_SIZE);
+    }
+}
+
+void PlanesEnvReset( PlanesEnv *env, int world)
+{
+    if (world >= 0 and world < env->config.worldCount)
+    {
+        env->worlds[world].StartMatch( env->config);
+    }
+    else if (world == -1)
+    {
+        for (auto &each : env->worlds)
+        {
+            each.StartMatch( env->config);
+        }
+    }
+}
+
+void PlanesEnvStep(
+    PlanesEnv *env,
+    const PlanesEnvAction *actions,
+    float *observations,
+    float *rewards,
+    uint8_t *dones)
+{
+    env->Step( actions, observations, rewards, dones);
+}
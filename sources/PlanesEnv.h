@@ -0,0 +1,114 @@
+#ifndef PLANES_ENV_H
+#define PLANES_ENV_H
+
+/**
+ * C API of a vectorized training environment, for training pilot policies
+ * offline.
+ *
+ * An environment holds a number of independent worlds, each with the same
+ * number of planes, that are simulated headless: without window, rendering,
+ * particles or audio, but with the same planes, bullets and collisions as
+ * the game. A single step applies one action to every plane of every world
+ * and advances all worlds together, spread over a pool of threads.
+ *
+ * All arrays are owned by the caller and are laid out per world, then per
+ * plane: the values of plane p in world w start at index
+ * (w * planesPerWorld + p) * size. Once the worlds have been running for a
+ * little while and their containers have grown to size, stepping does not
+ * allocate.
+ *
+ * Worlds do not end by themselves. A plane that is shot down or that
+ * collides crashes, gets a reward of -1 and is respawned a while later, as in
+ * the game. Its 'done' flag marks the step in which that happened, so a
+ * plane's life can be treated as an episode. A plane that hits another plane
+ * gets a reward of +1. PlanesEnvReset() starts a new match in a world.
+ *
+ * The observation of a plane is PLANES_ENV_OBSERVATION_SIZE floats, in the
+ * frame of the world, with positions and distances divided by the world
+ * size:
+ *
+ *   0, 1    position
+ *   2, 3    cosine and sine of the pitch
+ *   4       loaded bullets, as a fraction of the maximum
+ *   5       1 if the plane is flying and can fire and be hit, else 0
+ *   6, 7    offset to the nearest other flying plane, the shortest way
+ *           around the world, or 0 if there is none
+ *   8, 9    cosine and sine of the pitch of that plane
+ *   10      1 if there is such a plane, else 0
+ *   11, 12  offset to the nearest bullet of another plane, or 0 if there is
+ *           none
+ *   13      1 if there is such a bullet, else 0
+ */
+
+#include <stdint.h>
+
+#if defined( _WIN32)
+#define PLANES_ENV_API __declspec( dllexport)
+#else
+#define PLANES_ENV_API __attribute__(( visibility( "default")))
+#endif
+
+#define PLANES_ENV_OBSERVATION_SIZE 14
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PlanesEnv PlanesEnv;
+
+typedef struct PlanesEnvConfig
+{
+    int             worldCount;
+    int             planesPerWorld;
+    int             worldWidth;
+    int             worldHeight;
+    int             ticksPerStep;   ///< simulation ticks of 1/60 s per step, repeating the action
+    int             threadCount;    ///< 0 to use all hardware threads
+    unsigned int    seed;           ///< start positions and headings of the planes
+} PlanesEnvConfig;
+
+/// What a plane does during a step, the C counterpart of PlaneInput.
+typedef struct PlanesEnvAction
+{
+    int8_t  turn;   ///< -1 to turn left, +1 to turn right, 0 to fly straight on
+    uint8_t fire;   ///< non-zero to fire, if the plane has a loaded bullet
+} PlanesEnvAction;
+
+/// Two planes per world, in worlds as large as the game's window, one tick per step.
+PLANES_ENV_API PlanesEnvConfig PlanesEnvGetDefaultConfig( void);
+
+/// Returns null if the configuration is invalid.
+PLANES_ENV_API PlanesEnv *PlanesEnvCreate( const PlanesEnvConfig *config);
+PLANES_ENV_API void PlanesEnvDestroy( PlanesEnv *env);
+
+/// The total number of planes, which is the number of actions, rewards and done flags per step.
+PLANES_ENV_API int PlanesEnvGetPlaneCount( const PlanesEnv *env);
+
+/// Write the current observations of all planes.
+PLANES_ENV_API void PlanesEnvObserve( const PlanesEnv *env, float *observations);
+
+/**
+ * Start a new match in the given world, or in all worlds if world is -1: the
+ * planes start over at random positions and with no score. A world keeps the
+ * memory of its matches in an arena of its own, which a new match takes back
+ * at once, so resetting does not allocate once matches have settled in size.
+ */
+PLANES_ENV_API void PlanesEnvReset( PlanesEnv *env, int world);
+
+/**
+ * Apply the actions, advance all worlds and write the observations after
+ * the step, plus the rewards and done flags of the step. Each array has one
+ * entry per plane, or PLANES_ENV_OBSERVATION_SIZE for the observations.
+ */
+PLANES_ENV_API void PlanesEnvStep(
+    PlanesEnv *env,
+    const PlanesEnvAction *actions,
+    float *observations,
+    float *rewards,
+    uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLANES_ENV_H
@@ -0,0 +1,299 @@
+#include "Replay.h"
+
+#include "raylib.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined( _WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace { // unnamed
+
+    constexpr char headerMagic[8] = { 'P', 'L', 'A', 'N', 'E', 'R', 'P', 'L'};
+    constexpr char trailerMagic[8] = { 'P', 'L', 'A', 'N', 'E', 'I', 'D', 'X'};
+    constexpr std::uint32_t formatVersion = 1;
+
+    struct Header
+    {
+        char            magic[8];
+        std::uint32_t   version;
+        ReplayInfo      info;
+    };
+
+    struct Trailer
+    {
+        std::uint64_t   indexOffset;
+        std::uint64_t   keyframeCount;
+        std::uint64_t   tickCount;
+        char            magic[8];
+    };
+
+    enum RecordKind : std::uint8_t
+    {
+        TickRecord,
+        KeyframeRecord
+    };
+
+    template< typename Value>
+    void Write( std::FILE *file, const Value &value)
+    {
+        std::fwrite( &value, sizeof( Value), 1, file);
+    }
+}
+
+ReplayRecorder::ReplayRecorder( const char *path, const ReplayInfo &info)
+    : file( std::fopen( path, "wb")),
+    info( info)
+{
+    if (not file)
+    {
+        TraceLog( LOG_ERROR, "REPLAY: cannot open %s for writing", path);
+        return;
+    }
+
+    Header header = {};
+    std::memcpy( header.magic, headerMagic, sizeof( headerMagic));
+    header.version = formatVersion;
+    header.info = info;
+    Write( file, header);
+
+    // Room for the keyframes of more than an hour at the default interval.
+    index.reserve( 1024);
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+    if (not file)
+    {
+        return;
+    }
+
+    Trailer trailer = {};
+    trailer.indexOffset = static_cast<std::uint64_t>( std::ftell( file));
+    trailer.keyframeCount = index.size();
+    trailer.tickCount = tick;
+    std::memcpy( trailer.magic, trailerMagic, sizeof( trailerMagic));
+    std::fwrite( index.data(), sizeof( IndexEntry), index.size(), file);
+    Write( file, trailer);
+    std::fclose( file);
+}
+
+void ReplayRecorder::BeginTick( const Simulation &simulation)
+{
+    if (not file or tick % std::max( info.keyframeInterval, 1u) != 0)
+    {
+        return;
+    }
+
+    buffer.clear();
+    SnapshotWriter writer( buffer);
+    simulation.Save( writer);
+
+    index.push_back( { tick, static_cast<std::uint64_t>( std::ftell( file))});
+    Write( file, KeyframeRecord);
+    Write( file, tick);
+    Write( file, static_cast<std::uint32_t>( buffer.size()));
+    std::fwrite( buffer.data(), 1, buffer.size(), file);
+}
+
+void ReplayRecorder::RecordInputs( std::span<const PlaneInput> inputs, float deltaTime)
+{
+    if (not file)
+    {
+        return;
+    }
+
+    Write( file, TickRecord);
+    Write( file, deltaTime);
+    for (std::size_t plane = 0; plane < info.planeCount; ++plane)
+    {
+        const auto input = plane < inputs.size() ? inputs[plane] : PlaneInput{};
+        Write( file, input.turn);
+        Write( file, static_cast<std::uint8_t>( input.fire));
+    }
+    ++tick;
+}
+
+ReplayFile::ReplayFile( const char *path)
+{
+    std::span<const std::byte> bytes;
+#if !defined( _WIN32)
+    if (const int descriptor = open( path, O_RDONLY); descriptor >= 0)
+    {
+        struct stat status;
+        if (fstat( descriptor, &status) == 0 and status.st_size > 0)
+        {
+            const auto size = static_cast<std::size_t>( status.st_size);
+            if (void *address = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0); address != MAP_FAILED)
+            {
+                mapping = address;
+                mappingSize = size;
+                bytes = { static_cast<const std::byte*>( address), size};
+            }
+        }
+        close( descriptor);
+    }
+#endif
+    if (not mapping)
+    {
+        int size = 0;
+        if (unsigned char *fileData = LoadFileData( path, &size))
+        {
+            const auto *first = reinterpret_cast<const std::byte*>( fileData);
+            contents.assign( first, first + size);
+            UnloadFileData( fileData);
+        }
+        bytes = contents;
+    }
+
+    Header header;
+    Trailer trailer;
+    if (bytes.size() < sizeof( Header) + sizeof( Trailer))
+    {
+        TraceLog( LOG_ERROR, "REPLAY: %s is not a replay", path);
+        return;
+    }
+    std::memcpy( &header, bytes.data(), sizeof( Header));
+    std::memcpy( &trailer, bytes.data() + bytes.size() - sizeof( Trailer), sizeof( Trailer));
+    const auto indexEnd = bytes.size() - sizeof( Trailer);
+    if (std::memcmp( header.magic, headerMagic, sizeof( headerMagic)) != 0 or header.version != formatVersion)
+    {
+        TraceLog( LOG_ERROR, "REPLAY: %s is not a replay of this version", path);
+        return;
+    }
+    if (std::memcmp( trailer.magic, trailerMagic, sizeof( trailerMagic)) != 0
+        or trailer.indexOffset > indexEnd
+        or (indexEnd - trailer.indexOffset) / sizeof( IndexEntry) != trailer.keyframeCount)
+    {
+        TraceLog( LOG_ERROR, "REPLAY: %s is incomplete, the game did not finish recording it", path);
+        return;
+    }
+
+    info = header.info;
+    tickCount = trailer.tickCount;
+    index.resize( trailer.keyframeCount);
+    std::memcpy( index.data(), bytes.data() + trailer.indexOffset, index.size() * sizeof( IndexEntry));
+    inputs.resize( info.planeCount);
+    data = bytes;
+}
+
+ReplayFile::~ReplayFile()
+{
+#if !defined( _WIN32)
+    if (mapping)
+    {
+        munmap( mapping, mappingSize);
+    }
+#endif
+}
+
+template< typename Value>
+bool ReplayFile::Read( std::size_t &offset, Value &value) const
+{
+    if (offset > data.size() or data.size() - offset < sizeof( Value))
+    {
+        return false;
+    }
+    std::memcpy( &value, data.data() + offset, sizeof( Value));
+    offset += sizeof( Value);
+    return true;
+}
+
+bool ReplayFile::Seek( Simulation &simulation, std::uint64_t tick, Cursor &cursor)
+{
+    // Find the last keyframe at or before the tick.
+    auto keyframe = std::upper_bound( index.begin(), index.end(), tick, []( std::uint64_t tick, const IndexEntry &entry) {
+        return tick < entry.tick;
+    });
+    if (keyframe == index.begin())
+    {
+        return false;
+    }
+    --keyframe;
+
+    std::size_t offset = keyframe->offset;
+    RecordKind kind;
+    std::uint64_t keyframeTick;
+    std::uint32_t size;
+    if (not (Read( offset, kind) and Read( offset, keyframeTick) and Read( offset, size))
+        or kind != KeyframeRecord or data.size() - offset < size)
+    {
+        return false;
+    }
+    SnapshotReader reader( data.subspan( offset, size));
+    if (not simulation.Load( reader))
+    {
+        TraceLog( LOG_ERROR, "REPLAY: the keyframe of tick %llu does not fit the game", static_cast<unsigned long long>( keyframeTick));
+        return false;
+    }
+
+    cursor = { keyframeTick, offset + size};
+    while (cursor.tick < tick and Step( simulation, cursor))
+    {
+    }
+    return true;
+}
+
+bool ReplayFile::Step( Simulation &simulation, Cursor &cursor)
+{
+    if (not ReadTick( cursor))
+    {
+        return false;
+    }
+    simulation.Tick( inputs, cursor.deltaTime);
+    return true;
+}
+
+bool ReplayFile::ReadTick( Cursor &cursor)
+{
+    if (cursor.tick >= tickCount)
+    {
+        return false;
+    }
+
+    // Keyframes only matter when seeking, skip them when playing on.
+    std::size_t offset = cursor.offset;
+    RecordKind kind;
+    if (not Read( offset, kind))
+    {
+        return false;
+    }
+    if (kind == KeyframeRecord)
+    {
+        std::uint64_t keyframeTick;
+        std::uint32_t size;
+        if (not (Read( offset, keyframeTick) and Read( offset, size)))
+        {
+            return false;
+        }
+        offset += size;
+        if (not Read( offset, kind))
+        {
+            return false;
+        }
+    }
+
+    float deltaTime;
+    if (kind != TickRecord or not Read( offset, deltaTime))
+    {
+        return false;
+    }
+    for (auto &input : inputs)
+    {
+        std::uint8_t fire;
+        if (not (Read( offset, input.turn) and Read( offset, fire)))
+        {
+            return false;
+        }
+        input.fire = fire != 0;
+    }
+
+    cursor = { cursor.tick + 1, offset, deltaTime};
+    return true;
+}
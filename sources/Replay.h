@@ -0,0 +1,139 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "PlaneInput.h"
+#include "Simulation.h"
+#include "WorldBounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+/// What a replay needs to recreate the game before its first tick.
+struct ReplayInfo
+{
+    WorldBounds     world;
+    std::uint32_t   planeCount;
+    std::uint32_t   seed;               ///< the random seed with which the sky was created
+    std::uint32_t   keyframeInterval;   ///< ticks between keyframes
+};
+
+/**
+ * Writes the inputs of every tick of a game to a replay file, and every so
+ * many ticks a keyframe with the complete state of the simulation.
+ *
+ * A replay file starts with a header with the ReplayInfo, followed by
+ * records, each of which starts with its kind: a tick, with the duration of
+ * the tick and the input of every plane, or a keyframe, with the state of the
+ * simulation at the start of the tick that follows it. When the recorder is
+ * destroyed, it adds an index with the tick and the file offset of each
+ * keyframe and a trailer that says where the index is.
+ *
+ * Once the index has room for a long game and the keyframe buffer has grown
+ * to the size of a keyframe, recording does not allocate.
+ */
+class ReplayRecorder
+{
+public:
+    static constexpr std::uint32_t defaultKeyframeInterval = 300;
+
+    ReplayRecorder( const char *path, const ReplayInfo &info);
+    ~ReplayRecorder();
+
+    ReplayRecorder( const ReplayRecorder&) = delete;
+    ReplayRecorder &operator=( const ReplayRecorder&) = delete;
+
+    bool IsOpen() const { return file != nullptr; }
+
+    /// Call at the start of every tick, before Simulation::Tick(). Writes a keyframe when one is due.
+    void BeginTick( const Simulation &simulation);
+
+    /// Record the inputs that were applied during the tick and how long the tick took.
+    void RecordInputs( std::span<const PlaneInput> inputs, float deltaTime);
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t tick;
+        std::uint64_t offset;
+    };
+
+    std::FILE                  *file = nullptr;
+    ReplayInfo                  info;
+    std::uint64_t               tick = 0;
+    std::vector<IndexEntry>     index;
+    std::vector<std::byte>      buffer;
+};
+
+/**
+ * Reads a replay file through a memory mapping, so that opening even a long
+ * replay is instant and only the parts that are played are read from disk.
+ *
+ * Seeking restores the last keyframe at or before the requested tick and
+ * simulates the ticks from there headless, so it never takes more than a
+ * keyframe interval of ticks, wherever in the game it goes. The simulation
+ * must be created as the game was: with the world and the planes of the
+ * replay and with the random seed of the replay set before creating the sky.
+ */
+class ReplayFile
+{
+public:
+    /// A position in the replay: the tick that plays next and where its record is.
+    struct Cursor
+    {
+        std::uint64_t   tick = 0;
+        std::size_t     offset = 0;
+        float           deltaTime = 0.0f;   ///< seconds that the tick before it took
+    };
+
+    explicit ReplayFile( const char *path);
+    ~ReplayFile();
+
+    ReplayFile( const ReplayFile&) = delete;
+    ReplayFile &operator=( const ReplayFile&) = delete;
+
+    /// Whether the file could be read and is a complete replay.
+    bool IsOpen() const { return not data.empty(); }
+
+    const ReplayInfo &GetInfo() const { return info; }
+    std::uint64_t GetTickCount() const { return tickCount; }
+
+    /// Bring the simulation to the start of the given tick. Returns false if the replay does not fit the simulation.
+    bool Seek( Simulation &simulation, std::uint64_t tick, Cursor &cursor);
+
+    /// Simulate the tick at the cursor and move on to the next. Returns false at the end of the replay.
+    bool Step( Simulation &simulation, Cursor &cursor);
+
+    /**
+     * Read the tick at the cursor and move on to the next, without simulating
+     * it. The caller plays the tick with GetInputs() for cursor.deltaTime
+     * seconds, as Step() would. Returns false at the end of the replay.
+     */
+    bool ReadTick( Cursor &cursor);
+
+    /// The inputs of all planes in the tick that was read last, in the order of the planes.
+    std::span<const PlaneInput> GetInputs() const { return inputs; }
+
+private:
+    struct IndexEntry
+    {
+        std::uint64_t tick;
+        std::uint64_t offset;
+    };
+
+    template< typename Value>
+    bool Read( std::size_t &offset, Value &value) const;
+
+    std::span<const std::byte>  data;
+    void                       *mapping = nullptr;
+    std::size_t                 mappingSize = 0;
+    std::vector<std::byte>      contents;   ///< the file, where it cannot be mapped
+    ReplayInfo                  info = {};
+    std::uint64_t               tickCount = 0;
+    std::vector<IndexEntry>     index;
+    std::vector<PlaneInput>     inputs;
+};
+
+#endif // REPLAY_H
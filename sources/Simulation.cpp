@@ -0,0 +1,548 @@
+#include "Simulation.h"
+
+#include "DrawingUtilities.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+namespace { // unnamed
+
+    // Uniform handling of Update(). This defines concepts for updateable
+    // objects, rather than defining an Update() interface.
+
+    template< typename T>
+    concept SelfUpdateable = requires(T u, const WorldBounds &world, float deltaTime) {
+        u.Update(world, deltaTime);
+    };
+
+    void Update( SelfUpdateable auto &updateable, const WorldBounds &world, float deltaTime)
+    {
+        updateable.Update(world, deltaTime);
+    }
+
+    template< typename T>
+    concept Updateable = requires(T u, const WorldBounds &world, float deltaTime) {
+        Update( u, world, deltaTime);
+    };
+    template< typename T>
+    concept UpdateableRange = std::ranges::range<T> and Updateable<typename T::value_type>;
+
+    void Update( UpdateableRange auto &updateables, const WorldBounds &world, float deltaTime)
+    {
+        for (auto &updateable : updateables)
+        {
+            Update( updateable, world, deltaTime);
+        }
+    }
+
+    /**
+     * The box around the path of an object that has the given box at the end
+     * of an update in which it moved by 'displacement'.
+     */
+    Rectangle SweptBox( const Rectangle &box, Vector2 displacement)
+    {
+        return {
+            box.x - std::max( displacement.x, 0.0f),
+            box.y - std::max( displacement.y, 0.0f),
+            box.width + std::abs( displacement.x),
+            box.height + std::abs( displacement.y)};
+    }
+
+    /**
+     * Did two bullets of different owners pass within two bullet radii of each
+     * other during the last update?
+     */
+    bool BulletsCollide( const Bullet &bullet1, const Bullet &bullet2, const WorldBounds &world)
+    {
+        if (bullet1.GetOwner() == bullet2.GetOwner())
+        {
+            return false;
+        }
+
+        // The path of bullet2 relative to bullet1.
+        const Vector2 end = {
+            WrapDifference( GetPosition( bullet2).x - GetPosition( bullet1).x, static_cast<float>( world.width)),
+            WrapDifference( GetPosition( bullet2).y - GetPosition( bullet1).y, static_cast<float>( world.height))};
+        const Vector2 start = end - (GetDisplacement( bullet2) - GetDisplacement( bullet1));
+        const float distance = 2 * Bullet::radius;
+        return SegmentDistanceSquared( start, end, { 0, 0}) < distance * distance;
+    }
+}
+
+Simulation::Simulation(
+    WorldBounds bounds, CloudSystem clouds, std::size_t particleCapacity, std::pmr::memory_resource *resource)
+    : bounds( bounds),
+    planes( resource),
+    bullets( resource),
+    clouds( std::move( clouds), resource),
+    particles( particleCapacity, resource),
+    scores( resource),
+    collisionPipeline( resource),
+    commands( resource),
+    timers( TimerWheel<Timer>::defaultResolution, resource),
+    events( resource),
+    spentBullets( resource),
+    downedPlanes( resource),
+    despawnedBullets( resource),
+    history( TransformHistory::defaultDepth, resource),
+    lagTicks( resource),
+    pitches( resource),
+    sines( resource),
+    cosines( resource)
+{
+    using enum CollisionLayer;
+    collisionPipeline.SetInteraction( Planes, Bullets, true);
+    collisionPipeline.SetInteraction( Planes, Planes, true);
+    collisionPipeline.SetInteraction( Bullets, Bullets, true);
+    collisionPipeline.SetInteraction( Planes, Clouds, true);
+}
+
+void Simulation::Reserve( std::size_t planeCount)
+{
+    planes.reserve( planeCount);
+    scores.reserve( planeCount);
+    lagTicks.reserve( planeCount);
+    downedPlanes.reserve( planeCount);
+    history.Reserve( planeCount);
+    ReserveTickBuffers( planeCount);
+    spentBullets.reserve( bullets.capacity());
+}
+
+void Simulation::ReserveTickBuffers( std::size_t planeCount)
+{
+    bullets.reserve( planeCount * maxBulletsInFlightPerPlane);
+    commands.Reserve( planeCount, bullets.capacity());
+    timers.Reserve( bullets.capacity() + 2 * planeCount);
+    despawnedBullets.reserve( bullets.capacity());
+    events.reserve( bullets.capacity() + planeCount);
+    pitches.reserve( planeCount);
+    sines.reserve( planeCount);
+    cosines.reserve( planeCount);
+}
+
+void Simulation::Tick( std::span<const PlaneInput> inputs, float deltaTime)
+{
+    HandleGameMechanics();
+    ApplyInputs( inputs, deltaTime);
+    ApplyCommands();
+    UpdatePhysics( deltaTime);
+    DoCollisions();
+}
+
+void Simulation::HandleGameMechanics()
+{
+    events.clear();
+
+    // reset planes that are in crashed state
+    for (std::uint32_t index = 0; index < planes.size(); ++index)
+    {
+        auto &plane = planes[index];
+        if (plane.GetState() == Plane::Crashed)
+        {
+            // The plane hit the ground during the last tick.
+            LogEvent( EventRecord::StateChange, index, plane.GetPosition(), EventRecord::nobody, Plane::Crashing, Plane::Crashed);
+
+            // Planes respawn around the center, each heading away from it in
+            // its own direction, so that they don't respawn on top of each
+            // other.
+            const auto direction = static_cast<Angle256>( index * 256 / planes.size());
+            plane.Reset(
+                Vector2{ bounds.width / 2.0f, bounds.height / 2.0f } + Vector2{ cos( direction), sin( direction)} * respawnDistance,
+                220,
+                direction);
+            timers.Schedule( Plane::newbornTime, { Timer::PlaneMatured, index, plane.GetGeneration()});
+            LogEvent( EventRecord::Respawn, index, plane.GetPosition(), EventRecord::nobody, Plane::Crashed, Plane::Newborn);
+        }
+    }
+}
+
+void Simulation::ApplyInputs( std::span<const PlaneInput> inputs, float deltaTime)
+{
+    const auto count = std::min( inputs.size(), planes.size());
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        planes[index].Steer( inputs[index], deltaTime, commands);
+    }
+}
+
+void Simulation::UpdateTimers( float deltaTime)
+{
+    time += deltaTime;
+    timers.Advance( deltaTime, [this]( const Timer &timer)
+    {
+        OnTimer( timer);
+    });
+    ApplyCommands();
+}
+
+void Simulation::OnTimer( const Timer &timer)
+{
+    switch (timer.kind)
+    {
+    case Timer::BulletExpired:
+        {
+            // The bullets are in order of their serial numbers. The bullet
+            // may already be gone, for instance because it hit a plane.
+            const auto bullet = std::lower_bound(
+                bullets.begin(), bullets.end(), timer.serial,
+                []( const Bullet &bullet, std::uint64_t serial) { return bullet.GetSerial() < serial; });
+            if (bullet != bullets.end() and bullet->GetSerial() == timer.serial)
+            {
+                commands.DespawnBullet( static_cast<std::uint32_t>( bullet - bullets.begin()));
+            }
+        }
+        break;
+
+    case Timer::PlaneMatured:
+        // Ignore timers of earlier lives of the plane.
+        if (planes[timer.plane].GetGeneration() == timer.serial)
+        {
+            commands.ChangePlaneState( timer.plane, Plane::Newborn, Plane::Flying);
+        }
+        break;
+
+    case Timer::PlaneReloaded:
+        planes[timer.plane].FinishReload();
+        StartReload( timer.plane);
+        break;
+    }
+}
+
+void Simulation::StartReload( std::uint32_t planeIndex)
+{
+    auto &plane = planes[planeIndex];
+    if (plane.NeedsReload())
+    {
+        plane.StartReload( time + Plane::reloadTime);
+        timers.Schedule( Plane::reloadTime, { Timer::PlaneReloaded, planeIndex, 0});
+    }
+}
+
+void Simulation::UpdatePlanes( float deltaTime)
+{
+    // Plane::Update() in three passes: turn, compute the sines and cosines
+    // of all pitches in one batch and move.
+    pitches.clear();
+    for (auto &plane : planes)
+    {
+        plane.UpdatePitch( bounds, deltaTime);
+        pitches.push_back( plane.GetFinePitch());
+    }
+    sines.resize( planes.size());
+    cosines.resize( planes.size());
+    SinCos( pitches, sines, cosines);
+    for (std::size_t index = 0; index < planes.size(); ++index)
+    {
+        planes[index].Move( bounds, deltaTime, cosines[index], sines[index]);
+    }
+    history.Record( ++tick, planes);
+}
+
+void Simulation::SetLagCompensation( std::uint32_t plane, std::uint32_t ticks)
+{
+    lagTicks[plane] = std::min( ticks, static_cast<std::uint32_t>( history.GetDepth() - 1));
+    maxLagTicks = *std::max_element( lagTicks.begin(), lagTicks.end());
+}
+
+void Simulation::UpdateBullets( float deltaTime)
+{
+    Update( bullets, bounds, deltaTime);
+}
+
+void Simulation::UpdateClouds( float deltaTime)
+{
+    clouds.Update( deltaTime);
+}
+
+void Simulation::UpdateParticles( float deltaTime)
+{
+    for (const auto &plane : planes)
+    {
+        if (plane.GetState() == Plane::Crashing)
+        {
+            particles.EmitSmoke( plane.GetPosition(), deltaTime);
+        }
+    }
+    particles.Update( bounds, deltaTime);
+}
+
+void Simulation::DoCollisions()
+{
+    collisionPipeline.Begin( bounds);
+    for (std::uint32_t index = 0; index < planes.size(); ++index)
+    {
+        auto box = SweptBox( planes[index].GetBoundingBox(), GetDisplacement( planes[index]));
+        if (maxLagTicks > 0)
+        {
+            // Include where the plane was, and where it came from, as far back as bullets are judged.
+            box = history.GetBoundingBox( index, box, maxLagTicks + 1, bounds);
+        }
+        collisionPipeline.AddProxy( CollisionLayer::Planes, index, box);
+    }
+    for (std::uint32_t index = 0; index < bullets.size(); ++index)
+    {
+        const auto position = GetPosition( bullets[index]);
+        collisionPipeline.AddProxy(
+            CollisionLayer::Bullets, index,
+            SweptBox(
+                { position.x - Bullet::radius, position.y - Bullet::radius, 2 * Bullet::radius, 2 * Bullet::radius},
+                GetDisplacement( bullets[index])));
+    }
+    // Only the clouds that the planes fly in can be touched, layers further away are scenery.
+    if (const auto flying = clouds.GetFlyingLayer(); flying != CloudSystem::none)
+    {
+        const auto &layer = clouds.GetLayer( flying);
+        for (std::uint32_t index = layer.firstCloud; index < layer.firstCloud + layer.cloudCount; ++index)
+        {
+            collisionPipeline.AddProxy( CollisionLayer::Clouds, index, clouds.GetBoundingBox( index));
+        }
+    }
+
+    ApplyContacts( collisionPipeline.FindContacts( [this]( const Contact &contact)
+    {
+        return Touches( contact);
+    }));
+}
+
+bool Simulation::Touches( const Contact &contact) const
+{
+    using enum CollisionLayer;
+
+    const auto &first = contact.first;
+    const auto &second = contact.second;
+    if (contact.firstLayer == Planes and contact.secondLayer == Bullets)
+    {
+        // planes can't be hit by their own bullets.
+        const auto &bullet = bullets[second];
+        const auto owner = bullet.GetOwner();
+        if (owner == static_cast<int>( first))
+        {
+            return false;
+        }
+
+        // With lag compensation, the bullet hits the plane where its owner saw
+        // it, but only if that was in the current life of the plane.
+        const auto &plane = planes[first];
+        if (owner >= 0 and static_cast<std::size_t>( owner) < lagTicks.size() and lagTicks[owner] > 0)
+        {
+            const auto *then = history.Find( first, tick - lagTicks[owner]);
+            if (then and then->generation == plane.GetGeneration())
+            {
+                return plane.Collides( *then, GetPosition( bullet), GetDisplacement( bullet), bounds);
+            }
+        }
+        return plane.Collides( GetPosition( bullet), GetDisplacement( bullet), bounds);
+    }
+    else if (contact.firstLayer == Planes and contact.secondLayer == Planes)
+    {
+        return planes[first].CollidesWith( planes[second], bounds);
+    }
+    else if (contact.firstLayer == Bullets and contact.secondLayer == Bullets)
+    {
+        return BulletsCollide( bullets[first], bullets[second], bounds);
+    }
+    else if (contact.firstLayer == Planes and contact.secondLayer == Clouds)
+    {
+        return clouds.Contains( second, planes[first].GetPosition());
+    }
+    return false;
+}
+
+void Simulation::ApplyContacts( const CollisionPipeline::Contacts &contacts)
+{
+    using enum CollisionLayer;
+
+    for (auto &plane : planes)
+    {
+        plane.SetInCloud( false);
+    }
+
+    // Each bullet can only be used up once and each plane can only be brought
+    // down once.
+    spentBullets.assign( bullets.size(), false);
+    downedPlanes.assign( planes.size(), false);
+    const auto bringDown = [this]( std::uint32_t plane)
+    {
+        if (downedPlanes[plane] or planes[plane].GetState() != Plane::Flying)
+        {
+            return false;
+        }
+        downedPlanes[plane] = true;
+        commands.ChangePlaneState( plane, Plane::Flying, Plane::Crashing);
+        return true;
+    };
+    const auto spend = [this]( std::uint32_t bullet)
+    {
+        spentBullets[bullet] = true;
+        commands.DespawnBullet( bullet);
+    };
+
+    for (const auto &contact : contacts)
+    {
+        const auto &first = contact.first;
+        const auto &second = contact.second;
+        if (contact.firstLayer == Planes and contact.secondLayer == Bullets)
+        {
+            if (not spentBullets[second] and bringDown( first))
+            {
+                // A bullet of one player has hit a plane of another player.
+                LogEvent( EventRecord::Hit, static_cast<std::uint32_t>( bullets[second].GetOwner()), planes[first].GetPosition(), first);
+                spend( second);
+                commands.AddScore( bullets[second].GetOwner());
+            }
+        }
+        else if (contact.firstLayer == Planes and contact.secondLayer == Planes)
+        {
+            // A mid-air collision brings both planes down, but nobody scores.
+            if (planes[first].GetState() == Plane::Flying and planes[second].GetState() == Plane::Flying)
+            {
+                // Either plane may already have been brought down during this tick.
+                const bool firstDown = bringDown( first);
+                const bool secondDown = bringDown( second);
+                if (firstDown or secondDown)
+                {
+                    LogEvent( EventRecord::Collision, first, planes[first].GetPosition(), second);
+                }
+            }
+        }
+        else if (contact.firstLayer == Bullets and contact.secondLayer == Bullets)
+        {
+            // bullets that hit each other cancel each other out.
+            if (not spentBullets[first] and not spentBullets[second])
+            {
+                spend( first);
+                spend( second);
+            }
+        }
+        else if (contact.firstLayer == Planes and contact.secondLayer == Clouds)
+        {
+            // clouds are only sensors, they just let the plane know.
+            planes[first].SetInCloud( true);
+        }
+    }
+    ApplyCommands();
+}
+
+void Simulation::Save( SnapshotWriter &writer) const
+{
+    static_assert( std::is_trivially_copyable_v<Bullet>, "bullets are saved as they are in memory");
+
+    writer.Write( time);
+    writer.Write( tick);
+    writer.Write( nextBulletSerial);
+    writer.WriteArray( std::span<const int>( scores));
+    writer.Write( static_cast<std::uint32_t>( planes.size()));
+    for (const auto &plane : planes)
+    {
+        writer.Write( plane.GetSnapshot());
+    }
+    writer.WriteArray( std::span<const Bullet>( bullets));
+    timers.Save( writer);
+    clouds.Save( writer);
+    history.Save( writer);
+}
+
+bool Simulation::Load( SnapshotReader &reader)
+{
+    std::uint32_t planeCount = 0;
+    if (not (reader.Read( time) and reader.Read( tick) and reader.Read( nextBulletSerial)
+        and reader.ReadArray( scores) and reader.Read( planeCount))
+        or planeCount != planes.size() or scores.size() != planes.size())
+    {
+        return false;
+    }
+    for (auto &plane : planes)
+    {
+        Plane::Snapshot snapshot;
+        if (not reader.Read( snapshot))
+        {
+            return false;
+        }
+        plane.Restore( snapshot);
+    }
+    events.clear();
+    return reader.ReadArray( bullets) and timers.Load( reader) and clouds.Load( reader) and history.Load( reader);
+}
+
+void Simulation::ApplyCommands()
+{
+    for (const auto &change : commands.GetPlaneStateChanges())
+    {
+        auto &plane = planes[change.plane];
+        if (plane.GetState() == change.from)
+        {
+            plane.SetState( change.to);
+            LogEvent( EventRecord::StateChange, change.plane, plane.GetPosition(), EventRecord::nobody, change.from, change.to);
+            if (change.to == Plane::Crashing)
+            {
+                particles.EmitExplosion( plane.GetPosition(), plane.GetSpeedVector());
+                events.push_back( { GameEvent::PlaneDown, change.plane, plane.GetPosition()});
+            }
+        }
+    }
+
+    for (const auto &increment : commands.GetScoreIncrements())
+    {
+        scores[increment.plane] += increment.points;
+    }
+
+    const auto &despawns = commands.GetBulletDespawns();
+    if (not despawns.empty())
+    {
+        despawnedBullets.assign( bullets.size(), false);
+        for (const auto index : despawns)
+        {
+            despawnedBullets[index] = true;
+        }
+
+        // Remove the bullets in a single pass, keeping the others in order.
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < bullets.size(); ++index)
+        {
+            if (not despawnedBullets[index])
+            {
+                if (kept != index)
+                {
+                    bullets[kept] = bullets[index];
+                }
+                ++kept;
+            }
+        }
+        bullets.erase( bullets.begin() + kept, bullets.end());
+    }
+
+    // New bullets get the next serial numbers, which keeps the bullets
+    // ordered by serial number, and a timer for their expiry. A plane that
+    // has fired starts reloading, unless it already is.
+    for (const auto &spawn : commands.GetBulletSpawns())
+    {
+        auto &bullet = bullets.emplace_back( spawn);
+        bullet.SetSerial( nextBulletSerial++);
+        timers.Schedule( Bullet::lifeTime, { Timer::BulletExpired, 0, bullet.GetSerial()});
+        if (static_cast<std::size_t>( bullet.GetOwner()) < planes.size())
+        {
+            StartReload( bullet.GetOwner());
+            events.push_back( { GameEvent::Shot, static_cast<std::uint32_t>( bullet.GetOwner()), GetPosition( bullet)});
+            LogEvent( EventRecord::Shot, static_cast<std::uint32_t>( bullet.GetOwner()), GetPosition( bullet));
+        }
+        particles.EmitMuzzleFlash( GetPosition( bullet), GetSpeed( bullet));
+    }
+
+    commands.Clear();
+}
+
+void Simulation::LogEvent(
+    EventRecord::Kind kind, std::uint32_t plane, Vector2 position,
+    std::uint32_t other, Plane::State from, Plane::State to) const
+{
+    if (eventLog)
+    {
+        const auto generation = plane < planes.size() ? planes[plane].GetGeneration() : 0;
+        eventLog->Record( {
+            tick, position, plane, other, generation, kind,
+            static_cast<std::uint8_t>( from), static_cast<std::uint8_t>( to), 0});
+    }
+}
@@ -0,0 +1,255 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "Angle65536.h"
+#include "Bullet.h"
+#include "CloudSystem.h"
+#include "CollisionPipeline.h"
+#include "CommandBuffer.h"
+#include "EventLog.h"
+#include "GameEvent.h"
+#include "ParticleSystem.h"
+#include "TimerWheel.h"
+#include "TransformHistory.h"
+#include "Plane.h"
+#include "PlaneInput.h"
+#include "Snapshot.h"
+#include "WorldBounds.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+/**
+ * The state of the world and the rules that make it change: planes, bullets,
+ * clouds, the scores and the physics and collisions that drive them.
+ *
+ * The simulation has no knowledge of windows, input or audio, so that it can
+ * run both inside the game and headless, for instance in the stress harness.
+ * Controlling the planes is left to the owner of the simulation, which passes
+ * the inputs of the planes to Tick() or, to time its stages separately, runs
+ * those stages itself.
+ *
+ * Code that runs during a stage of a tick does not change the planes and
+ * bullets directly but records its changes in the command buffer of the
+ * simulation. The owner applies the buffer at the end of each stage that it
+ * runs, for instance after the controls, while DoCollisions() applies its own
+ * changes before it returns.
+ *
+ * Applying the commands is also where effects are started: every bullet that
+ * is spawned comes with a muzzle flash and every plane that starts crashing
+ * explodes. Both are also recorded as game events, for the owner to react to
+ * with sounds, for instance.
+ */
+class Simulation
+{
+public:
+    using Planes = std::pmr::vector<Plane>;
+
+    /**
+     * A simulation without anyone to watch it can do without particles, by
+     * passing a particle capacity of 0.
+     *
+     * All containers of the simulation, including those of the clouds, take
+     * their memory from the given resource, for instance the MatchArena of a
+     * match.
+     */
+    explicit Simulation(
+        WorldBounds bounds,
+        CloudSystem clouds = {},
+        std::size_t particleCapacity = ParticleSystem::defaultCapacity,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /**
+     * Add a plane to the world. The plane id is the index of the plane, which
+     * is also the index of the score of the plane.
+     */
+    template< typename... Arguments>
+    Plane &AddPlane( Arguments&&... arguments)
+    {
+        auto &plane = planes.emplace_back( static_cast<int>( planes.size()), std::forward<Arguments>(arguments)...);
+        scores.push_back( 0);
+        lagTicks.push_back( 0);
+        ReserveTickBuffers( planes.size());
+        history.SetPlaneCount( planes.size());
+        return plane;
+    }
+
+    /**
+     * Make room for this many planes before adding them, so that no container
+     * grows plane by plane. That matters most in a MatchArena, which does not
+     * reuse the memory that growing containers leave behind.
+     */
+    void Reserve( std::size_t planeCount);
+
+    /**
+     * Play one tick of the rules of the game with one input per plane: start
+     * the tick, apply the inputs, do the physics and the collisions. Every
+     * owner that plays the game ticks through here, so that a tick is the
+     * same in the game, in a replay and in the environment.
+     */
+    void Tick( std::span<const PlaneInput> inputs, float deltaTime);
+
+    /// Start a new tick: forget the events of the previous tick and reset planes that have crashed.
+    void HandleGameMechanics();
+
+    /**
+     * Let every plane turn and fire as its pilot wants, with one input per
+     * plane, in the order of the planes. Bullets that are fired are recorded
+     * in the command buffer.
+     */
+    void ApplyInputs( std::span<const PlaneInput> inputs, float deltaTime);
+
+    /**
+     * Advance the simulation time and handle the timers that expire: bullets
+     * that reach the end of their life, newborn planes that start flying and
+     * planes that finish reloading a bullet.
+     */
+    void UpdateTimers( float deltaTime);
+    void UpdatePlanes( float deltaTime);
+    void UpdateBullets( float deltaTime);
+    void UpdateClouds( float deltaTime);
+
+    /// Let crashing planes trail smoke and move and fade all particles.
+    void UpdateParticles( float deltaTime);
+    void UpdatePhysics( float deltaTime)
+    {
+        UpdateTimers( deltaTime);
+        UpdatePlanes( deltaTime);
+        UpdateBullets( deltaTime);
+        UpdateClouds( deltaTime);
+        UpdateParticles( deltaTime);
+    }
+
+    /**
+     * Find and handle all collisions: bullets that hit planes crash those
+     * planes and score for the shooters, planes that collide both crash,
+     * bullets of different players cancel each other out and planes learn
+     * whether they are inside a cloud.
+     */
+    void DoCollisions();
+
+    /// The buffer in which the current stage records its changes.
+    CommandBuffer &GetCommands() { return commands; }
+
+    /// Apply and clear all recorded changes.
+    void ApplyCommands();
+
+    /// What happened since the start of the current tick.
+    const std::pmr::vector<GameEvent> &GetEvents() const { return events; }
+
+    /**
+     * Judge the hits of the bullets of a plane against where the other planes
+     * were the given number of ticks ago, which is what the player of the
+     * plane saw with their latency. The number is limited to the depth of the
+     * transform history, 0 judges against where the planes are now.
+     */
+    void SetLagCompensation( std::uint32_t plane, std::uint32_t ticks);
+
+    /// The number of times that the planes have moved, which is the newest tick in the transform history.
+    std::uint64_t GetTick() const { return tick; }
+    const TransformHistory &GetTransformHistory() const { return history; }
+
+    /**
+     * Write the state of the world between two ticks: the planes, bullets,
+     * timers, scores, clouds and the transform history, which lagged bullets
+     * are judged against. Particles are only for show and are not saved.
+     */
+    void Save( SnapshotWriter &writer) const;
+
+    /**
+     * Read what Save() wrote, into a simulation with the same planes and sky.
+     * Returns false if the snapshot does not fit, which leaves the simulation
+     * in an undefined state.
+     */
+    bool Load( SnapshotReader &reader);
+
+    /**
+     * Write shots, hits, collisions, respawns and state changes of planes to
+     * the given log, or stop logging with nullptr. The log must outlive the
+     * simulation, or logging must be stopped first.
+     */
+    void SetEventLog( EventLog *log) { eventLog = log; }
+
+    /// Choose which layers interact, for instance to switch off bullets hitting bullets.
+    CollisionPipeline &GetCollisionPipeline() { return collisionPipeline; }
+    const CollisionPipeline &GetCollisionPipeline() const { return collisionPipeline; }
+
+    /// The contacts that were found by the last call to DoCollisions().
+    const CollisionPipeline::Contacts &GetContacts() const { return collisionPipeline.GetContacts(); }
+
+    void SetBounds( WorldBounds bounds) { this->bounds = bounds; }
+    const WorldBounds &GetBounds() const { return bounds; }
+
+    /// Seconds of simulated time.
+    double GetTime() const { return time; }
+
+    Planes &GetPlanes() { return planes; }
+    const Planes &GetPlanes() const { return planes; }
+    Bullets &GetBullets() { return bullets; }
+    const Bullets &GetBullets() const { return bullets; }
+    const CloudSystem &GetClouds() const { return clouds; }
+    const ParticleSystem &GetParticles() const { return particles; }
+    int GetScore( std::size_t planeIndex) const { return scores[planeIndex]; }
+
+private:
+    static constexpr std::size_t maxBulletsInFlightPerPlane = 8;
+    static constexpr float respawnDistance = 20.0f;
+
+    struct Timer
+    {
+        enum Kind : std::uint8_t
+        {
+            BulletExpired,
+            PlaneMatured,
+            PlaneReloaded
+        };
+
+        Kind            kind;
+        std::uint32_t   plane;
+        std::uint64_t   serial;     ///< serial number of the bullet or generation of the plane
+    };
+
+    /**
+     * Each plane can have at most a handful of bullets in flight, reserve
+     * enough room so that firing never needs to grow the vector, nor the
+     * buffers that are used to change it.
+     */
+    void ReserveTickBuffers( std::size_t planeCount);
+    void OnTimer( const Timer &timer);
+    void StartReload( std::uint32_t planeIndex);
+    bool Touches( const Contact &contact) const;
+    void ApplyContacts( const CollisionPipeline::Contacts &contacts);
+    void LogEvent(
+        EventRecord::Kind kind, std::uint32_t plane, Vector2 position,
+        std::uint32_t other = EventRecord::nobody,
+        Plane::State from = Plane::Flying, Plane::State to = Plane::Flying) const;
+
+    WorldBounds         bounds;
+    Planes              planes;
+    Bullets             bullets;
+    CloudSystem         clouds;
+    ParticleSystem      particles;
+    std::pmr::vector<int> scores;
+    CollisionPipeline   collisionPipeline;
+    CommandBuffer       commands;
+    TimerWheel<Timer>   timers;
+    double              time = 0.0;
+    std::uint64_t       nextBulletSerial = 0;
+    std::pmr::vector<GameEvent> events;
+    std::pmr::vector<bool> spentBullets;
+    std::pmr::vector<bool> downedPlanes;
+    std::pmr::vector<bool> despawnedBullets;
+    TransformHistory    history;
+    std::uint64_t       tick = 0;
+    std::pmr::vector<std::uint32_t> lagTicks;   ///< per plane, for the bullets that it fires
+    std::pmr::vector<Angle65536> pitches;       ///< per plane, the batch of UpdatePlanes()
+    std::pmr::vector<float> sines;
+    std::pmr::vector<float> cosines;
+    std::uint32_t       maxLagTicks = 0;
+    EventLog           *eventLog = nullptr;
+};
+
+#endif // SIMULATION_H
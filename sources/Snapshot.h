@@ -0,0 +1,107 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Writes the state of the simulation into a flat buffer of bytes, for
+ * instance for the keyframes of a replay.
+ *
+ * Values are written as they are in memory, so a snapshot can only be read
+ * by the same build on the same kind of machine. That is all that replays
+ * need, as they re-simulate with the same code anyway.
+ */
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter( std::vector<std::byte> &buffer) : buffer( buffer) {}
+
+    template< typename Value>
+    void Write( const Value &value)
+    {
+        static_assert( std::is_trivially_copyable_v<Value>);
+        const auto bytes = std::as_bytes( std::span( &value, 1));
+        buffer.insert( buffer.end(), bytes.begin(), bytes.end());
+    }
+
+    /// Write the number of values, followed by the values.
+    template< typename Value>
+    void WriteArray( std::span<const Value> values)
+    {
+        static_assert( std::is_trivially_copyable_v<Value>);
+        Write( static_cast<std::uint32_t>( values.size()));
+        const auto bytes = std::as_bytes( values);
+        buffer.insert( buffer.end(), bytes.begin(), bytes.end());
+    }
+
+private:
+    std::vector<std::byte> &buffer;
+};
+
+/**
+ * Reads what a SnapshotWriter wrote. Reading past the end of the data fails
+ * the reader, after which all reads fail and leave their values alone.
+ */
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader( std::span<const std::byte> data) : data( data) {}
+
+    template< typename Value>
+    bool Read( Value &value)
+    {
+        static_assert( std::is_trivially_copyable_v<Value>);
+        if (not Have( sizeof( Value)))
+        {
+            return false;
+        }
+        std::memcpy( &value, data.data() + offset, sizeof( Value));
+        offset += sizeof( Value);
+        return true;
+    }
+
+    /// Read the values that WriteArray() wrote, replacing the contents of the vector.
+    template< typename Value, typename Allocator>
+    bool ReadArray( std::vector<Value, Allocator> &values)
+    {
+        static_assert( std::is_trivially_copyable_v<Value>);
+        std::uint32_t count = 0;
+        if (not Read( count) or not Have( std::size_t{ count} * sizeof( Value)))
+        {
+            return false;
+        }
+        // Copy through aligned storage, as the data may not be aligned and
+        // the values need not be default constructible.
+        values.clear();
+        values.reserve( count);
+        for (std::uint32_t index = 0; index < count; ++index)
+        {
+            alignas( Value) std::byte storage[sizeof( Value)];
+            std::memcpy( storage, data.data() + offset, sizeof( Value));
+            values.push_back( *std::launder( reinterpret_cast<const Value*>( storage)));
+            offset += sizeof( Value);
+        }
+        return true;
+    }
+
+    bool Failed() const { return failed; }
+
+private:
+    bool Have( std::size_t size)
+    {
+        failed = failed or data.size() - offset < size;
+        return not failed;
+    }
+
+    std::span<const std::byte>  data;
+    std::size_t                 offset = 0;
+    bool                        failed = false;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,438 @@
+#include "StressHarness.h"
+
+#include "AiPilots.h"
+#include "AllocationTracker.h"
+#include "EventLog.h"
+#include "FrameTelemetry.h"
+#include "MatchArena.h"
+#include "Simulation.h"
+#include "VectorMath.h"
+#include "raylib.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <vector>
+
+#if defined( __linux__)
+#include <unistd.h>
+#endif
+
+namespace {
+
+    /**
+     * The phases of a simulation tick that the harness times separately.
+     */
+    enum HarnessPhase
+    {
+        Mechanics,
+        Controls,
+        Timers,
+        PlanePhysics,
+        BulletPhysics,
+        CloudPhysics,
+        ParticlePhysics,
+        Collisions,
+        PhaseCount
+    };
+
+    constexpr std::array<const char *, PhaseCount> phaseNames = {
+        "mechanics", "controls", "timers", "planes", "bullets", "clouds", "particles", "collisions"};
+
+    std::string Trim( const std::string &text)
+    {
+        const auto begin = text.find_first_not_of( " \t\r");
+        if (begin == std::string::npos)
+        {
+            return {};
+        }
+        const auto end = text.find_last_not_of( " \t\r");
+        return text.substr( begin, end - begin + 1);
+    }
+
+    template< typename Value>
+    bool Parse( const std::string &text, Value &value)
+    {
+        std::istringstream stream( text);
+        stream >> std::boolalpha >> value;
+        return not stream.fail();
+    }
+
+    /// Resident set size of this process in KiB, or zero if unknown.
+    long GetResidentSetSize()
+    {
+#if defined( __linux__)
+        long pages = 0;
+        long residentPages = 0;
+        if (auto file = std::fopen( "/proc/self/statm", "r"))
+        {
+            if (std::fscanf( file, "%ld %ld", &pages, &residentPages) != 2)
+            {
+                residentPages = 0;
+            }
+            std::fclose( file);
+        }
+        return residentPages * (sysconf( _SC_PAGESIZE) / 1024);
+#else
+        return 0;
+#endif
+    }
+
+    float GetRandomFraction()
+    {
+        constexpr int randomScale = 4096;
+        return GetRandomValue( 0, randomScale) / static_cast<float>( randomScale);
+    }
+
+    Vector2 GetRandomPosition( const WorldBounds &bounds)
+    {
+        return { GetRandomFraction() * bounds.width, GetRandomFraction() * bounds.height};
+    }
+
+    /**
+     * Set up a world as described by the scenario.
+     */
+    void Populate( Simulation &simulation, const Scenario &scenario)
+    {
+        simulation.Reserve( scenario.planes);
+        for (int plane = 0; plane < scenario.planes; ++plane)
+        {
+            simulation.AddPlane(
+                plane % 2 ? "red" : "green",
+                plane % 2 ? RED : DARKGREEN,
+                GetRandomPosition( simulation.GetBounds()),
+                220,
+                static_cast<Angle256>( GetRandomValue( 0, 255)));
+        }
+        simulation.GetBullets().reserve( simulation.GetBullets().capacity() + scenario.liveBullets);
+    }
+
+    /**
+     * Keep every plane turning slowly, each in its own direction, and firing
+     * whenever it has bullets.
+     */
+    void FireContinuously( Simulation &simulation, float deltaTime)
+    {
+        auto &commands = simulation.GetCommands();
+        auto &planes = simulation.GetPlanes();
+        const auto turn = static_cast<std::int32_t>( std::lround( Plane::turnRate / 2 * deltaTime));
+        for (std::size_t index = 0; index < planes.size(); ++index)
+        {
+            if (planes[index].GetState() == Plane::Flying)
+            {
+                planes[index].DeltaPitch( index % 2 ? turn : -turn);
+                planes[index].Fire( commands);
+            }
+        }
+    }
+
+    /// Let the computer pilots think and fly all planes.
+    void FlyWithPilots( Simulation &simulation, AiPilots &pilots, std::span<PlaneInput> inputs, float deltaTime)
+    {
+        pilots.Think( simulation);
+        pilots.GetInputs( simulation.GetPlanes(), deltaTime, inputs);
+        simulation.ApplyInputs( inputs, deltaTime);
+    }
+
+    /**
+     * Add bullets in random directions until there are at least the given
+     * number of bullets in flight.
+     */
+    void TopUpBullets( Simulation &simulation, std::size_t liveBullets)
+    {
+        auto &commands = simulation.GetCommands();
+        const auto planeCount = static_cast<int>( simulation.GetPlanes().size());
+        const auto inFlight = simulation.GetBullets().size() + commands.GetBulletSpawns().size();
+        for (auto count = inFlight; count < liveBullets; ++count)
+        {
+            const auto direction = static_cast<Angle256>( GetRandomValue( 0, 255));
+            commands.SpawnBullet(
+                BLACK,
+                planeCount ? GetRandomValue( 0, planeCount - 1) : 0,
+                GetRandomPosition( simulation.GetBounds()),
+                Vector2{ cos( direction), sin( direction)} * 440.0f);
+        }
+    }
+
+    /// Force a number of planes to crash, so that the game mechanics respawn them.
+    void ForceCrashes( Simulation &simulation, int crashes)
+    {
+        const auto &planes = simulation.GetPlanes();
+        for (int crash = 0; crash < crashes and not planes.empty(); ++crash)
+        {
+            const auto index = static_cast<std::uint32_t>( GetRandomValue( 0, static_cast<int>( planes.size()) - 1));
+            simulation.GetCommands().ChangePlaneState( index, planes[index].GetState(), Plane::Crashed);
+        }
+    }
+
+    CloudSystem CreateClouds( const Scenario &scenario)
+    {
+        const WorldBounds world = { scenario.worldWidth, scenario.worldHeight};
+        CloudLayerSettings flyingLayer;
+        flyingLayer.clouds = scenario.clouds;
+        flyingLayer.circlesPerCloud = scenario.cloudCircles;
+        flyingLayer.drawnCircles = scenario.cloudCircles;
+        if (scenario.sky)
+        {
+            return CreateRandomSky( world, flyingLayer);
+        }
+
+        CloudSystem clouds;
+        clouds.AddLayer( world, flyingLayer);
+        return clouds;
+    }
+}
+
+std::optional<Scenario> LoadScenario( const std::string &path)
+{
+    std::ifstream file( path);
+    if (not file)
+    {
+        TraceLog( LOG_ERROR, "STRESS: cannot open scenario file %s", path.c_str());
+        return std::nullopt;
+    }
+
+    Scenario scenario;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline( file, line))
+    {
+        ++lineNumber;
+        line = Trim( line);
+        if (line.empty() or line[0] == '#')
+        {
+            continue;
+        }
+
+        const auto separator = line.find( '=');
+        const auto key = Trim( line.substr( 0, separator));
+        const auto value = separator == std::string::npos ? std::string{} : Trim( line.substr( separator + 1));
+
+        bool parsed = false;
+        if (key == "name")                  { scenario.name = value; parsed = not value.empty(); }
+        else if (key == "ticks")            parsed = Parse( value, scenario.ticks);
+        else if (key == "tick_rate")        parsed = Parse( value, scenario.tickRate) and scenario.tickRate > 0;
+        else if (key == "world_width")      parsed = Parse( value, scenario.worldWidth);
+        else if (key == "world_height")     parsed = Parse( value, scenario.worldHeight);
+        else if (key == "planes")           parsed = Parse( value, scenario.planes);
+        else if (key == "firing")           parsed = Parse( value, scenario.firing);
+        else if (key == "ai_pilots")        parsed = Parse( value, scenario.aiPilots);
+        else if (key == "live_bullets")     parsed = Parse( value, scenario.liveBullets);
+        else if (key == "clouds")           parsed = Parse( value, scenario.clouds);
+        else if (key == "cloud_circles")    parsed = Parse( value, scenario.cloudCircles);
+        else if (key == "sky")              parsed = Parse( value, scenario.sky);
+        else if (key == "crashes_per_tick") parsed = Parse( value, scenario.crashesPerTick);
+        else if (key == "lag_compensation_ticks") parsed = Parse( value, scenario.lagCompensationTicks) and scenario.lagCompensationTicks >= 0;
+        else if (key == "arena")            parsed = Parse( value, scenario.arena);
+        else if (key == "event_log")        { scenario.eventLog = value; parsed = not value.empty(); }
+        else if (key == "collide_planes")   parsed = Parse( value, scenario.collidePlanes);
+        else if (key == "collide_bullets")  parsed = Parse( value, scenario.collideBullets);
+        else if (key == "cloud_sensors")    parsed = Parse( value, scenario.cloudSensors);
+        else if (key == "seed")             parsed = Parse( value, scenario.seed);
+        else if (key == "allocation_gate")  parsed = Parse( value, scenario.allocationGate);
+        else if (key == "warmup_ticks")     parsed = Parse( value, scenario.warmupTicks);
+
+        if (not parsed)
+        {
+            TraceLog( LOG_ERROR, "STRESS: %s:%d: cannot parse '%s'", path.c_str(), lineNumber, line.c_str());
+            return std::nullopt;
+        }
+    }
+    return scenario;
+}
+
+bool RunScenario( const char *scenarioPath, const char *csvPath)
+{
+    using Clock = std::chrono::steady_clock;
+
+    const auto scenario = LoadScenario( scenarioPath);
+    if (not scenario)
+    {
+        return false;
+    }
+
+    if (scenario->allocationGate and not AllocationTracker::enabled)
+    {
+        TraceLog( LOG_ERROR, "STRESS: allocation_gate requires a build with PLANES_TRACK_ALLOCATIONS");
+        return false;
+    }
+
+    std::FILE *csv = csvPath ? std::fopen( csvPath, "w") : stdout;
+    if (not csv)
+    {
+        TraceLog( LOG_ERROR, "STRESS: cannot open %s for writing", csvPath);
+        return false;
+    }
+
+    // The log and the arena must outlive the simulation that uses them.
+    std::optional<EventLog> eventLog;
+    if (not scenario->eventLog.empty())
+    {
+        eventLog.emplace( scenario->eventLog.c_str());
+    }
+    std::optional<MatchArena> arena;
+    if (scenario->arena)
+    {
+        arena.emplace();
+    }
+
+    SetRandomSeed( scenario->seed);
+    Simulation simulation(
+        { scenario->worldWidth, scenario->worldHeight},
+        CreateClouds( *scenario),
+        ParticleSystem::defaultCapacity,
+        arena ? &*arena : std::pmr::get_default_resource());
+    Populate( simulation, *scenario);
+    if (eventLog)
+    {
+        simulation.SetEventLog( &*eventLog);
+    }
+    auto &collisionPipeline = simulation.GetCollisionPipeline();
+    collisionPipeline.SetInteraction( CollisionLayer::Planes, CollisionLayer::Planes, scenario->collidePlanes);
+    collisionPipeline.SetInteraction( CollisionLayer::Bullets, CollisionLayer::Bullets, scenario->collideBullets);
+    collisionPipeline.SetInteraction( CollisionLayer::Planes, CollisionLayer::Clouds, scenario->cloudSensors);
+    const auto cloudCircles = simulation.GetClouds().GetCircleCount();
+    for (std::uint32_t plane = 0; plane < simulation.GetPlanes().size(); ++plane)
+    {
+        simulation.SetLagCompensation( plane, static_cast<std::uint32_t>( scenario->lagCompensationTicks));
+    }
+
+    AiPilots pilots;
+    for (std::size_t plane = 0; scenario->aiPilots and plane < simulation.GetPlanes().size(); ++plane)
+    {
+        pilots.AddPilot( plane);
+    }
+    std::vector<PlaneInput> inputs( simulation.GetPlanes().size());
+
+    std::fprintf( csv, "tick");
+    for (const auto name : phaseNames)
+    {
+        std::fprintf( csv, ",%s_us", name);
+    }
+    std::fprintf( csv, ",total_us,planes,flying,bullets,clouds,cloud_circles,particles,contacts,allocations,allocated_bytes,rss_kb\n");
+
+    const float deltaTime = 1.0f / scenario->tickRate;
+    std::array<DurationHistogram, PhaseCount + 1> histograms;
+    AllocationTracker allocationTracker;
+    allocationTracker.SetWarmupFrames( scenario->warmupTicks);
+
+    // The stages of Simulation::Tick(), run one by one to time each of them
+    // and with the load of the scenario added between them.
+    for (int tick = 0; tick < scenario->ticks; ++tick)
+    {
+        std::array<Clock::time_point, PhaseCount + 1> marks;
+        allocationTracker.BeginFrame();
+
+        marks[Mechanics] = Clock::now();
+        ForceCrashes( simulation, scenario->crashesPerTick);
+        simulation.ApplyCommands();
+        simulation.HandleGameMechanics();
+
+        allocationTracker.BeginPhase( FramePhase::Controls);
+        marks[Controls] = Clock::now();
+        if (scenario->aiPilots)
+        {
+            FlyWithPilots( simulation, pilots, inputs, deltaTime);
+        }
+        else if (scenario->firing)
+        {
+            FireContinuously( simulation, deltaTime);
+        }
+        TopUpBullets( simulation, scenario->liveBullets);
+        simulation.ApplyCommands();
+
+        allocationTracker.BeginPhase( FramePhase::Physics);
+        marks[Timers] = Clock::now();
+        simulation.UpdateTimers( deltaTime);
+        marks[PlanePhysics] = Clock::now();
+        simulation.UpdatePlanes( deltaTime);
+        marks[BulletPhysics] = Clock::now();
+        simulation.UpdateBullets( deltaTime);
+        marks[CloudPhysics] = Clock::now();
+        simulation.UpdateClouds( deltaTime);
+        marks[ParticlePhysics] = Clock::now();
+        simulation.UpdateParticles( deltaTime);
+
+        allocationTracker.BeginPhase( FramePhase::Collisions);
+        marks[Collisions] = Clock::now();
+        simulation.DoCollisions();
+        marks[PhaseCount] = Clock::now();
+
+        allocationTracker.EndFrame();
+
+        std::fprintf( csv, "%d", tick);
+        for (int phase = 0; phase < PhaseCount; ++phase)
+        {
+            const auto duration = std::chrono::duration<double>( marks[phase + 1] - marks[phase]).count();
+            histograms[phase].Record( duration);
+            std::fprintf( csv, ",%.1f", duration * 1e6);
+        }
+        const auto total = std::chrono::duration<double>( marks[PhaseCount] - marks[Mechanics]).count();
+        histograms[PhaseCount].Record( total);
+
+        std::size_t flying = 0;
+        for (const auto &plane : simulation.GetPlanes())
+        {
+            flying += plane.GetState() == Plane::Flying;
+        }
+        const auto &allocations = allocationTracker.GetFrameCounts();
+        std::fprintf(
+            csv, ",%.1f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%ld\n",
+            total * 1e6,
+            simulation.GetPlanes().size(),
+            flying,
+            simulation.GetBullets().size(),
+            simulation.GetClouds().GetCloudCount(),
+            cloudCircles,
+            simulation.GetParticles().GetCount(),
+            simulation.GetContacts().size(),
+            allocations.allocations,
+            allocations.bytes,
+            GetResidentSetSize());
+    }
+
+    if (csvPath)
+    {
+        std::fclose( csv);
+    }
+
+    TraceLog( LOG_INFO, "STRESS: scenario '%s', %d ticks at %d Hz", scenario->name.c_str(), scenario->ticks, scenario->tickRate);
+    for (int phase = 0; phase <= PhaseCount; ++phase)
+    {
+        TraceLog(
+            LOG_INFO, "STRESS:   %-10s p50 %9.1f us, p99 %9.1f us, max %9.1f us",
+            phase < PhaseCount ? phaseNames[phase] : "total",
+            histograms[phase].GetPercentile( 50) * 1e6,
+            histograms[phase].GetPercentile( 99) * 1e6,
+            histograms[phase].GetMax() * 1e6);
+    }
+
+    if (arena)
+    {
+        TraceLog(
+            LOG_INFO, "STRESS: the simulation used %zu KiB of its arena of %zu KiB",
+            arena->GetUsedBytes() / 1024, arena->GetCapacity() / 1024);
+        if (arena->GetOverflowBytes())
+        {
+            TraceLog(
+                LOG_WARNING, "STRESS: the arena was full, %zu KiB of that came from the heap",
+                arena->GetOverflowBytes() / 1024);
+        }
+    }
+
+    if (scenario->allocationGate)
+    {
+        const auto failedTicks = allocationTracker.GetAllocatingFrameCount();
+        TraceLog(
+            failedTicks ? LOG_ERROR : LOG_INFO, "STRESS: %zu ticks after the warm-up allocated heap memory",
+            failedTicks);
+        return failedTicks == 0;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef STRESS_HARNESS_H
+#define STRESS_HARNESS_H
+
+#include <optional>
+#include <string>
+
+/**
+ * Description of a headless load scenario.
+ *
+ * Scenarios are read from small text files with one 'key = value' pair per
+ * line. Empty lines and lines starting with '#' are ignored. The keys are the
+ * snake_case versions of the member names below, e.g. 'live_bullets = 50000'.
+ *
+ * The collision keys default to the rules of the game. Scenarios that were
+ * written before planes and bullets collided with each other turn those
+ * collisions off, so that they keep measuring what they always did: bullets
+ * that hit planes.
+ */
+struct Scenario
+{
+    std::string name = "unnamed";
+    int ticks = 600;
+    int tickRate = 60;              ///< simulation ticks per second
+    int worldWidth = 1024;
+    int worldHeight = 768;
+    int planes = 2;
+    bool firing = false;            ///< all planes turn and fire whenever they can
+    bool aiPilots = false;          ///< computer pilots fly all planes, instead of 'firing'
+    int liveBullets = 0;            ///< keep at least this many bullets in flight
+    int clouds = 4;
+    int cloudCircles = 24;          ///< circles per cloud
+    bool sky = false;               ///< add the distant cloud layers that the game draws behind the planes
+    int crashesPerTick = 0;         ///< planes forced to crash each tick, to be respawned
+    bool collidePlanes = true;      ///< planes that touch each other both crash
+    bool collideBullets = true;     ///< bullets of different planes cancel each other out
+    bool cloudSensors = true;       ///< planes detect whether they are in a cloud
+    int lagCompensationTicks = 0;   ///< judge the hits of all planes against where their targets were this many ticks ago
+    std::string eventLog;           ///< write the gameplay events to this file, see EventLog
+    bool arena = false;             ///< take the memory of the simulation from a MatchArena rather than the heap
+    unsigned int seed = 1;
+    bool allocationGate = false;    ///< fail if any tick after the warm-up allocates
+    int warmupTicks = 60;
+};
+
+std::optional<Scenario> LoadScenario( const std::string &path);
+
+/**
+ * Run the scenario in the given file headless and write one CSV row per tick
+ * with per-phase timings, entity counts and memory use to the file csvPath,
+ * or to stdout if csvPath is null.
+ *
+ * Returns false if the scenario could not be loaded or if it has an allocation
+ * gate and a tick after the warm-up allocated heap memory.
+ */
+bool RunScenario( const char *scenarioPath, const char *csvPath);
+
+#endif // STRESS_HARNESS_H
@@ -0,0 +1,203 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+/**
+ * Schedules events to fire after a delay, so that entities don't each need to
+ * count down their own timers every tick.
+ *
+ * Time advances in steps of 'resolution' seconds. The wheel has several
+ * levels of 64 slots: the first level holds the timers that expire within the
+ * next 64 steps, one slot per step. Each next level covers a range that is 64
+ * times larger, with a slot for every 64 slots of the level below. Whenever a
+ * level has gone full circle, the timers of the next slot of the level above
+ * are moved down. Scheduling a timer and firing it both take constant time,
+ * and a step in which no timers expire costs next to nothing, no matter how
+ * many timers are waiting.
+ *
+ * The timers are linked lists of nodes in a single pool. Nodes of expired
+ * timers are reused, so the wheel only allocates when more timers are waiting
+ * than ever before.
+ */
+template< typename Payload>
+class TimerWheel
+{
+public:
+    static constexpr float defaultResolution = 1.0f / 120;
+
+    explicit TimerWheel(
+        float resolution = defaultResolution,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : resolution( resolution),
+        nodes( resource)
+    {
+        for (auto &level : slots)
+        {
+            level.fill( none);
+        }
+    }
+
+    /// Make room for this many waiting timers.
+    void Reserve( std::size_t timers) { nodes.reserve( timers); }
+
+    /// Fire 'payload' once 'delay' seconds have passed, but not before the next step.
+    void Schedule( float delay, const Payload &payload)
+    {
+        const auto steps = static_cast<std::uint64_t>( std::max( 1.0f, std::round( delay / resolution)));
+        Insert( Allocate( { now + std::min( steps, maxSteps), none, payload}));
+    }
+
+    /**
+     * Move time forward and call fire( payload) for every timer that expires,
+     * in order of expiry. Timers that fire may schedule new timers.
+     */
+    template< typename Fire>
+    void Advance( float deltaTime, Fire &&fire)
+    {
+        pendingTime += deltaTime;
+        while (pendingTime >= resolution)
+        {
+            pendingTime -= resolution;
+            Step( fire);
+        }
+    }
+
+    std::size_t GetWaitingCount() const { return waiting; }
+
+    /**
+     * Write the complete state of the wheel, so that timers that fire in the
+     * same step still fire in the same order after loading it.
+     */
+    void Save( SnapshotWriter &writer) const
+    {
+        writer.Write( pendingTime);
+        writer.Write( now);
+        writer.Write( freeList);
+        writer.Write( slots);
+        writer.WriteArray( std::span<const Node>( nodes));
+    }
+
+    bool Load( SnapshotReader &reader)
+    {
+        if (not (reader.Read( pendingTime) and reader.Read( now) and reader.Read( freeList)
+            and reader.Read( slots) and reader.ReadArray( nodes)))
+        {
+            return false;
+        }
+        waiting = nodes.size();
+        for (auto index = freeList; index != none and index < nodes.size(); index = nodes[index].next)
+        {
+            --waiting;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int slotBits = 6;
+    static constexpr std::uint32_t slotCount = 1u << slotBits;
+    static constexpr std::uint32_t slotMask = slotCount - 1;
+    static constexpr int levelCount = 4;
+    static constexpr std::uint64_t maxSteps = (std::uint64_t{ 1} << (slotBits * levelCount)) - 1;
+    static constexpr std::uint32_t none = ~std::uint32_t{ 0};
+
+    struct Node
+    {
+        std::uint64_t   due;    ///< step at which the timer fires
+        std::uint32_t   next;   ///< next node in the same slot, or in the free list
+        Payload         payload;
+    };
+
+    std::uint32_t Allocate( const Node &node)
+    {
+        ++waiting;
+        if (freeList != none)
+        {
+            const auto index = freeList;
+            freeList = nodes[index].next;
+            nodes[index] = node;
+            return index;
+        }
+        nodes.push_back( node);
+        return static_cast<std::uint32_t>( nodes.size() - 1);
+    }
+
+    void Free( std::uint32_t index)
+    {
+        --waiting;
+        nodes[index].next = freeList;
+        freeList = index;
+    }
+
+    /// Link a node into the slot of the lowest level that can hold its due step.
+    void Insert( std::uint32_t index)
+    {
+        auto &node = nodes[index];
+        const auto distance = node.due - now;
+        int level = 0;
+        while (level < levelCount - 1 and distance >= (std::uint64_t{ 1} << (slotBits * (level + 1))))
+        {
+            ++level;
+        }
+        auto &head = slots[level][(node.due >> (slotBits * level)) & slotMask];
+        node.next = head;
+        head = index;
+    }
+
+    /// Unlink all nodes from a slot and return the first.
+    std::uint32_t Take( int level, std::uint32_t slot)
+    {
+        const auto first = slots[level][slot];
+        slots[level][slot] = none;
+        return first;
+    }
+
+    template< typename Fire>
+    void Step( Fire &fire)
+    {
+        ++now;
+
+        // Move timers down from the levels above that have come round.
+        for (int level = 1; level < levelCount; ++level)
+        {
+            if ((now & ((std::uint64_t{ 1} << (slotBits * level)) - 1)) != 0)
+            {
+                break;
+            }
+            for (auto index = Take( level, (now >> (slotBits * level)) & slotMask); index != none;)
+            {
+                const auto next = nodes[index].next;
+                Insert( index);
+                index = next;
+            }
+        }
+
+        for (auto index = Take( 0, now & slotMask); index != none;)
+        {
+            const auto next = nodes[index].next;
+            const auto payload = nodes[index].payload;
+            Free( index);
+            fire( payload);
+            index = next;
+        }
+    }
+
+    float                   resolution;
+    float                   pendingTime = 0.0f;
+    std::uint64_t           now = 0;
+    std::size_t             waiting = 0;
+    std::pmr::vector<Node>  nodes;
+    std::uint32_t           freeList = none;
+    std::array<std::array<std::uint32_t, slotCount>, levelCount> slots;
+};
+
+#endif // TIMER_WHEEL_H
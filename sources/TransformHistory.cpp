@@ -0,0 +1,86 @@
+#include "TransformHistory.h"
+
+#include "DrawingUtilities.h"
+
+#include <algorithm>
+#include <bit>
+
+TransformHistory::TransformHistory( std::size_t depth, std::pmr::memory_resource *resource)
+    : rowMask( std::bit_ceil( std::max<std::size_t>( depth, 1)) - 1),
+    transforms( resource)
+{
+}
+
+void TransformHistory::SetPlaneCount( std::size_t planeCount)
+{
+    this->planeCount = planeCount;
+    transforms.resize( GetDepth() * planeCount);
+    recordedTicks = 0;
+}
+
+void TransformHistory::Record( std::uint64_t tick, std::span<const Plane> planes)
+{
+    if (planes.size() != planeCount)
+    {
+        SetPlaneCount( planes.size());
+    }
+
+    auto row = transforms.begin() + (tick & rowMask) * planeCount;
+    for (const auto &plane : planes)
+    {
+        *row++ = plane.GetTransform();
+    }
+
+    // A gap in the ticks leaves rows of older ticks in between, forget those.
+    recordedTicks = (recordedTicks and tick == newestTick + 1) ? std::min<std::uint64_t>( recordedTicks + 1, GetDepth()) : 1;
+    newestTick = tick;
+}
+
+Rectangle TransformHistory::GetBoundingBox(
+    std::uint32_t plane, Rectangle current, std::size_t ticks, const WorldBounds &world) const
+{
+    if (recordedTicks == 0 or plane >= planeCount)
+    {
+        return current;
+    }
+
+    // The box moves along with the plane, its size stays the same. Offsets
+    // are wrapped, so that the box stays next to the current one when the
+    // plane has crossed an edge of the world since.
+    Vector2 minimum = { 0.0f, 0.0f };
+    Vector2 maximum = minimum;
+    const auto now = transforms[(newestTick & rowMask) * planeCount + plane].position;
+    const auto count = std::min<std::uint64_t>( ticks + 1, recordedTicks);
+    for (std::uint64_t back = 1; back < count; ++back)
+    {
+        const auto then = transforms[((newestTick - back) & rowMask) * planeCount + plane].position;
+        const Vector2 offset = {
+            WrapDifference( then.x - now.x, static_cast<float>( world.width)),
+            WrapDifference( then.y - now.y, static_cast<float>( world.height))};
+        minimum = { std::min( minimum.x, offset.x), std::min( minimum.y, offset.y) };
+        maximum = { std::max( maximum.x, offset.x), std::max( maximum.y, offset.y) };
+    }
+    return {
+        current.x + minimum.x,
+        current.y + minimum.y,
+        current.width + maximum.x - minimum.x,
+        current.height + maximum.y - minimum.y };
+}
+
+void TransformHistory::Save( SnapshotWriter &writer) const
+{
+    writer.Write( newestTick);
+    writer.Write( recordedTicks);
+    writer.WriteArray( std::span<const Plane::Transform>( transforms));
+}
+
+bool TransformHistory::Load( SnapshotReader &reader)
+{
+    if (not (reader.Read( newestTick) and reader.Read( recordedTicks) and reader.ReadArray( transforms))
+        or transforms.size() != GetDepth() * planeCount)
+    {
+        recordedTicks = 0;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef TRANSFORM_HISTORY_H
+#define TRANSFORM_HISTORY_H
+
+#include "Plane.h"
+#include "raylib.h"
+#include "Snapshot.h"
+#include "WorldBounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+/**
+ * The transforms of all planes during the last ticks, so that hits can be
+ * judged against where a player saw the other planes rather than against
+ * where they are now on the server.
+ *
+ * The history is a ring of rows, one row per tick with the transforms of all
+ * planes in order. Recording a tick overwrites the oldest row in one go, and
+ * finding the transform of a plane at a tick is a matter of computing its
+ * index. The ring has a power of two rows, so that a tick maps to its row with
+ * a mask. Memory is allocated when the number of planes changes, never while
+ * recording or rewinding.
+ */
+class TransformHistory
+{
+public:
+    static constexpr std::size_t defaultDepth = 64;
+
+    /// Keep at least 'depth' ticks, rounded up to a power of two.
+    explicit TransformHistory(
+        std::size_t depth = defaultDepth,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /// Make room for this many planes. This forgets the history.
+    void SetPlaneCount( std::size_t planeCount);
+
+    /// Allocate room for up to this many planes, without changing the current number.
+    void Reserve( std::size_t planeCount) { transforms.reserve( GetDepth() * planeCount); }
+
+    /// Store the transforms of the planes at the given tick, which should follow the last recorded one.
+    void Record( std::uint64_t tick, std::span<const Plane> planes);
+
+    /// The transform of the plane at the given tick, or nullptr if that tick is not in the history.
+    const Plane::Transform *Find( std::uint32_t plane, std::uint64_t tick) const
+    {
+        if (recordedTicks == 0 or tick > newestTick or newestTick - tick >= recordedTicks or plane >= planeCount)
+        {
+            return nullptr;
+        }
+        return &transforms[(tick & rowMask) * planeCount + plane];
+    }
+
+    std::size_t GetDepth() const { return rowMask + 1; }
+
+    /**
+     * Grow the current box of a plane to cover it at all of the given number
+     * of ticks before the newest one, so that a broadphase finds hits on any
+     * of them.
+     */
+    Rectangle GetBoundingBox( std::uint32_t plane, Rectangle current, std::size_t ticks, const WorldBounds &world) const;
+
+    /// Write all rows, so that hits are judged the same after loading them.
+    void Save( SnapshotWriter &writer) const;
+
+    /// Read what Save() wrote for the same number of planes and depth.
+    bool Load( SnapshotReader &reader);
+
+private:
+    std::size_t                     rowMask;
+    std::size_t                     planeCount = 0;
+    std::uint64_t                   newestTick = 0;
+    std::uint64_t                   recordedTicks = 0;  ///< up to the depth
+    std::pmr::vector<Plane::Transform> transforms;
+};
+
+#endif // TRANSFORM_HISTORY_H
@@ -0,0 +1,59 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Passes the latest version of a value from one thread to another, without
+ * locks and without either thread ever waiting for the other.
+ *
+ * Of the three copies of the value, the writer owns one, the reader owns one
+ * and the third is in between. Publishing swaps the writer's copy with the
+ * one in between and marks it as fresh. The reader swaps its copy with the one
+ * in between only when that is fresh. The reader may skip versions, but always
+ * sees a complete one.
+ *
+ * Only one thread may write and only one thread may read.
+ */
+template< typename Value>
+class TripleBuffer
+{
+public:
+    /// The copy that the writer fills in before it calls Publish().
+    Value &GetWriteBuffer() { return slots[writeSlot]; }
+
+    /// Make the write buffer the latest version and get another one to write to.
+    void Publish()
+    {
+        const auto previous = middle.exchange( writeSlot | freshFlag, std::memory_order_acq_rel);
+        writeSlot = previous & indexMask;
+    }
+
+    /// Take the latest version for the reader, if there is a new one. Returns whether there was.
+    bool Update()
+    {
+        if (not (middle.load( std::memory_order_relaxed) & freshFlag))
+        {
+            return false;
+        }
+        const auto previous = middle.exchange( readSlot, std::memory_order_acq_rel);
+        readSlot = previous & indexMask;
+        return true;
+    }
+
+    /// The latest version that the reader took with Update().
+    const Value &GetReadBuffer() const { return slots[readSlot]; }
+
+private:
+    static constexpr std::uint8_t indexMask = 0x3;
+    static constexpr std::uint8_t freshFlag = 0x4;
+
+    std::array< Value, 3>       slots{};
+    std::uint8_t                writeSlot = 0;
+    std::atomic<std::uint8_t>   middle{ 1};
+    std::uint8_t                readSlot = 2;
+};
+
+#endif // TRIPLE_BUFFER_H
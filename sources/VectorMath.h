@@ -1,10 +1,12 @@
 #ifndef VECTOR_MATH_H
 #define VECTOR_MATH_H
 
-#include "Angle256.h"
+#include "Angle65536.h"
 #include "raylib.h"
 
-inline Vector2 Rotate( const Vector2& vector, Angle256 angle)
+#include <algorithm>
+
+inline Vector2 Rotate( const Vector2& vector, Angle65536 angle)
 {
     return {
         vector.x * cos(angle) - vector.y * sin(angle),
@@ -59,4 +61,31 @@ inline bool operator!=(const Vector2& lhs, const Vector2& rhs)
     return !(lhs == rhs);
 }
 
+// Calculates the dot product of two vectors.
+inline float Vector2DotProduct(Vector2 v1, Vector2 v2)
+{
+    return v1.x * v2.x + v1.y * v2.y;
+}
+
+// Calculates the squared distance between two Vector2 points.
+inline float Vector2DistanceSquared(Vector2 v1, Vector2 v2)
+{
+    return (v1.x - v2.x) * (v1.x - v2.x) + (v1.y - v2.y) * (v1.y - v2.y);
+}
+
+// Calculates the squared distance between a point and the closest point on
+// the line segment from start to end.
+inline float SegmentDistanceSquared(Vector2 start, Vector2 end, Vector2 point)
+{
+    const Vector2 segment = end - start;
+    const float lengthSquared = segment.x * segment.x + segment.y * segment.y;
+    float t = 0.0f;
+    if (lengthSquared > 0.0f)
+    {
+        const Vector2 toPoint = point - start;
+        t = std::clamp( (toPoint.x * segment.x + toPoint.y * segment.y) / lengthSquared, 0.0f, 1.0f);
+    }
+    return Vector2DistanceSquared( start + segment * t, point);
+}
+
 #endif // VECTOR_MATH_H
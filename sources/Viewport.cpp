@@ -0,0 +1,66 @@
+#include "Viewport.h"
+
+#include "DrawingUtilities.h"
+
+Viewport::Viewport( Rectangle screenArea, WorldBounds world)
+    : screenArea( screenArea),
+    world( world),
+    target{ world.width / 2.0f, world.height / 2.0f}
+{
+}
+
+void Viewport::LookAt( Vector2 target)
+{
+    this->target = target;
+}
+
+void Viewport::Follow( Vector2 target, float deltaTime)
+{
+    // Close most of the distance within a second, independent of the frame rate.
+    constexpr float remainingAfterSecond = 0.01f;
+    const float step = 1.0f - std::pow( remainingAfterSecond, deltaTime);
+    const float width = static_cast<float>( world.width);
+    const float height = static_cast<float>( world.height);
+    this->target = {
+        Wrap( this->target.x + WrapDifference( target.x - this->target.x, width) * step, width),
+        Wrap( this->target.y + WrapDifference( target.y - this->target.y, height) * step, height)};
+}
+
+Rectangle Viewport::GetVisibleArea() const
+{
+    return {
+        target.x - screenArea.width / 2.0f,
+        target.y - screenArea.height / 2.0f,
+        screenArea.width,
+        screenArea.height};
+}
+
+bool Viewport::IsVisible( Rectangle box) const
+{
+    bool visible = false;
+    ForEachVisibleCopy( box, [&]( Vector2) { visible = true; });
+    return visible;
+}
+
+void Viewport::Begin() const
+{
+    BeginScissorMode(
+        static_cast<int>( screenArea.x), static_cast<int>( screenArea.y),
+        static_cast<int>( screenArea.width), static_cast<int>( screenArea.height));
+    BeginMode2D( GetCamera());
+}
+
+void Viewport::End() const
+{
+    EndMode2D();
+    EndScissorMode();
+}
+
+Camera2D Viewport::GetCamera() const
+{
+    return {
+        { screenArea.x + screenArea.width / 2.0f, screenArea.y + screenArea.height / 2.0f},
+        target,
+        0.0f,
+        1.0f};
+}
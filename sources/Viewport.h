@@ -0,0 +1,86 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include "raylib.h"
+#include "WorldBounds.h"
+
+#include <cmath>
+
+/**
+ * A part of the screen that shows a part of the world, through a camera that
+ * looks at a point of the world.
+ *
+ * The world wraps around at its edges, so what a viewport shows may cross
+ * those edges or, if the viewport is larger than the world, show parts of the
+ * world more than once. Entities are drawn by asking for the copies of their
+ * bounding box, shifted by whole worlds, that are visible. Entities that
+ * are not visible at all are not drawn.
+ */
+class Viewport
+{
+public:
+    Viewport( Rectangle screenArea, WorldBounds world);
+
+    void SetScreenArea( Rectangle screenArea) { this->screenArea = screenArea; }
+    Rectangle GetScreenArea() const { return screenArea; }
+    void SetWorld( WorldBounds world) { this->world = world; }
+    const WorldBounds &GetWorld() const { return world; }
+
+    /// Center the viewport on the given point of the world.
+    void LookAt( Vector2 target);
+
+    /**
+     * Move the camera a step towards the given point of the world, the
+     * shortest way around the world, so that it follows a moving target
+     * smoothly.
+     */
+    void Follow( Vector2 target, float deltaTime);
+    Vector2 GetTarget() const { return target; }
+
+    /**
+     * The part of the world that is visible, in world coordinates that may
+     * lie beyond the edges of the world.
+     */
+    Rectangle GetVisibleArea() const;
+
+    /**
+     * Call visit( shift) for every copy of the box, shifted by whole world
+     * sizes, that is at least partly visible. Nothing is called if the box is
+     * not visible at all.
+     */
+    template< typename Visit>
+    void ForEachVisibleCopy( Rectangle box, Visit &&visit) const
+    {
+        const auto visible = GetVisibleArea();
+        const float width = static_cast<float>( world.width);
+        const float height = static_cast<float>( world.height);
+
+        // The shifts k * width for which box and visible area overlap.
+        const int firstX = static_cast<int>( std::floor( (visible.x - box.x - box.width) / width)) + 1;
+        const int lastX = static_cast<int>( std::ceil( (visible.x + visible.width - box.x) / width)) - 1;
+        const int firstY = static_cast<int>( std::floor( (visible.y - box.y - box.height) / height)) + 1;
+        const int lastY = static_cast<int>( std::ceil( (visible.y + visible.height - box.y) / height)) - 1;
+        for (int y = firstY; y <= lastY; ++y)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                visit( Vector2{ x * width, y * height});
+            }
+        }
+    }
+
+    bool IsVisible( Rectangle box) const;
+
+    /// Start drawing into the viewport, in world coordinates.
+    void Begin() const;
+    void End() const;
+
+private:
+    Camera2D GetCamera() const;
+
+    Rectangle   screenArea;
+    WorldBounds world;
+    Vector2     target;     ///< the point of the world at the center of the viewport
+};
+
+#endif // VIEWPORT_H
@@ -0,0 +1,16 @@
+#ifndef WORLD_BOUNDS_H
+#define WORLD_BOUNDS_H
+
+/**
+ * The dimensions of the world that the planes fly in.
+ *
+ * The world wraps around at its edges. Its dimensions are kept separate from
+ * the GameWindow so that the world can also be simulated without a window.
+ */
+struct WorldBounds
+{
+    int width;
+    int height;
+};
+
+#endif // WORLD_BOUNDS_H
@@ -0,0 +1,159 @@
+#include "WrapRenderer.h"
+
+#include "rlgl.h"
+#include "Viewport.h"
+
+#include <algorithm>
+
+namespace { // unnamed
+
+    /// The fraction of the radius of the circle texture at which it starts to fade out.
+    constexpr float circleDensity = 0.9f;
+
+    /**
+     * Half the size of the quad of a circle, relative to its radius. The quad
+     * reaches a bit beyond the radius, so that the circle fades out around its
+     * actual edge.
+     */
+    constexpr float circleQuadScale = 2.0f / (1.0f + circleDensity);
+
+    /**
+     * A white disc that fades out at its edge, for drawing circles as quads.
+     * It fades to transparent white rather than black, so that filtering does
+     * not darken the edge.
+     */
+    Texture2D GetCircleTexture()
+    {
+        static const Texture2D texture = []{
+            Image image = GenImageGradientRadial( 64, 64, circleDensity, WHITE, Color{ 255, 255, 255, 0});
+            const auto texture = LoadTextureFromImage( image);
+            UnloadImage( image);
+            SetTextureFilter( texture, TEXTURE_FILTER_BILINEAR);
+            return texture;
+        }();
+        return texture;
+    }
+
+    Rectangle GetBounds( const Vector2 (&corners)[4])
+    {
+        float left = corners[0].x;
+        float right = left;
+        float top = corners[0].y;
+        float bottom = top;
+        for (const auto &corner : corners)
+        {
+            left = std::min( left, corner.x);
+            right = std::max( right, corner.x);
+            top = std::min( top, corner.y);
+            bottom = std::max( bottom, corner.y);
+        }
+        return { left, top, right - left, bottom - top };
+    }
+}
+
+void WrapRenderer::AddSprite(
+    const Texture2D &texture,
+    Vector2 position,
+    Vector2 origin,
+    Angle65536 angle,
+    Color tint,
+    bool wrapVertically)
+{
+    // The corners of the rotated texture, as raylib's DrawTexturePro() computes them.
+    const float cosine = cos( angle);
+    const float sine = sin( angle);
+    const float left = -origin.x;
+    const float right = texture.width - origin.x;
+    const float top = -origin.y;
+    const float bottom = texture.height - origin.y;
+    const auto Rotate = [&]( float x, float y) {
+        return Vector2{ position.x + x * cosine - y * sine, position.y + x * sine + y * cosine};
+    };
+
+    Sprite sprite = {
+        texture.id,
+        0,
+        { Rotate( left, top), Rotate( left, bottom), Rotate( right, bottom), Rotate( right, top)},
+        tint};
+    viewport->ForEachVisibleCopy( GetBounds( sprite.corners), [&]( Vector2 shift)
+    {
+        if (wrapVertically or shift.y == 0.0f)
+        {
+            auto &copy = sprites.emplace_back( sprite);
+            copy.order = static_cast<std::uint32_t>( sprites.size());
+            for (auto &corner : copy.corners)
+            {
+                corner = { corner.x + shift.x, corner.y + shift.y};
+            }
+        }
+    });
+}
+
+void WrapRenderer::AddCircle( Vector2 center, float radius, Color color)
+{
+    const float half = radius * circleQuadScale;
+    viewport->ForEachVisibleCopy( { center.x - half, center.y - half, 2 * half, 2 * half}, [&]( Vector2 shift)
+    {
+        circles.push_back( { { center.x + shift.x, center.y + shift.y}, radius, color});
+    });
+}
+
+void WrapRenderer::Flush()
+{
+    // Sort on texture, so that each texture needs only one batch. Sorting on
+    // the order too keeps overlapping sprites of the same texture in order,
+    // without the buffer that a stable sort would allocate.
+    std::sort( sprites.begin(), sprites.end(), []( const Sprite &a, const Sprite &b) {
+        return a.texture != b.texture ? a.texture < b.texture : a.order < b.order;
+    });
+
+    for (std::size_t first = 0; first < sprites.size();)
+    {
+        const auto texture = sprites[first].texture;
+        rlSetTexture( texture);
+        rlBegin( RL_QUADS);
+        for (; first < sprites.size() and sprites[first].texture == texture; ++first)
+        {
+            const auto &sprite = sprites[first];
+            rlColor4ub( sprite.tint.r, sprite.tint.g, sprite.tint.b, sprite.tint.a);
+            rlTexCoord2f( 0.0f, 0.0f);
+            rlVertex2f( sprite.corners[0].x, sprite.corners[0].y);
+            rlTexCoord2f( 0.0f, 1.0f);
+            rlVertex2f( sprite.corners[1].x, sprite.corners[1].y);
+            rlTexCoord2f( 1.0f, 1.0f);
+            rlVertex2f( sprite.corners[2].x, sprite.corners[2].y);
+            rlTexCoord2f( 1.0f, 0.0f);
+            rlVertex2f( sprite.corners[3].x, sprite.corners[3].y);
+        }
+        rlEnd();
+    }
+
+    if (not circles.empty())
+    {
+        rlSetTexture( GetCircleTexture().id);
+        rlBegin( RL_QUADS);
+        for (const auto &circle : circles)
+        {
+            const float half = circle.radius * circleQuadScale;
+            const float left = circle.center.x - half;
+            const float right = circle.center.x + half;
+            const float top = circle.center.y - half;
+            const float bottom = circle.center.y + half;
+
+            rlColor4ub( circle.color.r, circle.color.g, circle.color.b, circle.color.a);
+            rlTexCoord2f( 0.0f, 0.0f);
+            rlVertex2f( left, top);
+            rlTexCoord2f( 0.0f, 1.0f);
+            rlVertex2f( left, bottom);
+            rlTexCoord2f( 1.0f, 1.0f);
+            rlVertex2f( right, bottom);
+            rlTexCoord2f( 1.0f, 0.0f);
+            rlVertex2f( right, top);
+        }
+        rlEnd();
+    }
+    rlSetTexture( 0);
+
+    sprites.clear();
+    circles.clear();
+}
@@ -0,0 +1,76 @@
+#ifndef WRAP_RENDERER_H
+#define WRAP_RENDERER_H
+
+#include "Angle65536.h"
+#include "raylib.h"
+
+#include <cstdint>
+#include <vector>
+
+class Viewport;
+
+/**
+ * Collects the sprites and circles of a layer of the world and draws them in
+ * as few batches as possible, including the copies that show because the
+ * world wraps around.
+ *
+ * Everything that is added is given by its position in the world. The
+ * renderer computes the exact bounds of each shape, asks the viewport which
+ * copies of those bounds are visible and stores one instance per visible copy.
+ * Shapes out of view are dropped, a shape on an edge gets two instances and
+ * one on a corner four. Flush() then submits the instances: sprites sorted by
+ * texture, one batch of quads per texture, and then circles as quads with a
+ * shared round texture, all in a single batch.
+ *
+ * Layers that must appear on top of each other should each be flushed before
+ * the next layer is added. The renderer keeps the capacity of its buffers, so
+ * it does not allocate once it has drawn a few frames.
+ */
+class WrapRenderer
+{
+public:
+    /// Draw into the given viewport, which must outlive the calls that follow.
+    void SetViewport( const Viewport &viewport) { this->viewport = &viewport; }
+    const Viewport &GetViewport() const { return *viewport; }
+
+    /**
+     * Add the texture, rotated by 'angle' around the point 'origin' of the
+     * texture, with that point at 'position'. With wrapVertically false, only
+     * the copies on the same height are drawn, for things that have left the
+     * world at the bottom.
+     */
+    void AddSprite(
+        const Texture2D &texture,
+        Vector2 position,
+        Vector2 origin,
+        Angle65536 angle,
+        Color tint,
+        bool wrapVertically = true);
+
+    void AddCircle( Vector2 center, float radius, Color color);
+
+    /// Draw everything that was added since the last flush, in the viewport's camera.
+    void Flush();
+
+private:
+    struct Sprite
+    {
+        unsigned int    texture;
+        std::uint32_t   order;      ///< sprites with the same texture are drawn in the order in which they were added
+        Vector2         corners[4]; ///< top left, bottom left, bottom right, top right of the texture
+        Color           tint;
+    };
+
+    struct Circle
+    {
+        Vector2 center;
+        float   radius;
+        Color   color;
+    };
+
+    const Viewport         *viewport = nullptr;
+    std::vector<Sprite>     sprites;
+    std::vector<Circle>     circles;
+};
+
+#endif // WRAP_RENDERER_H
@@ -1,18 +1,41 @@
+#include "AiPilots.h"
+#include "AllocationTracker.h"
 #include "CloudSystem.h"
+#include "EventLog.h"
+#include "CommandBuffer.h"
+#include "EngineMixer.h"
+#include "DrawingUtilities.h"
+#include "FramePacer.h"
+#include "FrameTelemetry.h"
+#include "GameEvent.h"
 #include "GameWindow.h"
+#include "GunVoicePool.h"
+#include "InputLatencyProbe.h"
 #include "Plane.h"
+#include "PlaneInput.h"
 #include "raylib.h"
+#include "Replay.h"
+#include "Simulation.h"
+#include "StressHarness.h"
 #include "VectorMath.h"
+#include "Viewport.h"
+#include "WrapRenderer.h"
 #include "Bullet.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
-#include <functional>
-#include <iomanip>
-#include <set>
-#include <sstream>
-#include <tuple>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
 
 #if defined( EMSCRIPTEN)
 #include <emscripten/emscripten.h>
@@ -30,131 +53,109 @@ namespace { // unnamed
     // rather than defining a Draw() interface.
 
     template<typename T>
-    concept SelfDrawable = requires(T d, const GameWindow &window) {
-        d.Draw(window);
+    concept SelfDrawable = requires(T d, WrapRenderer &renderer) {
+        d.Draw(renderer);
     };
 
-    void Draw( const SelfDrawable auto &drawable, const GameWindow &window)
+    void Draw( const SelfDrawable auto &drawable, WrapRenderer &renderer)
     {
-        drawable.Draw( window);
+        drawable.Draw( renderer);
     }
 
     template< typename T>
-    concept Drawable = requires(const T d, const GameWindow &window) {
-        Draw( d, window);
+    concept Drawable = requires(const T d, WrapRenderer &renderer) {
+        Draw( d, renderer);
     };
 
     template<typename T>
     concept DrawableRange = std::ranges::range<T> and Drawable<typename T::value_type>;
 
-    void Draw( const DrawableRange auto &drawables, const GameWindow &window)
+    void Draw( const DrawableRange auto &drawables, WrapRenderer &renderer)
     {
         for (const auto &drawable : drawables)
         {
-            Draw( drawable, window);
-        }
-    }
-
-    template< typename T>
-    concept SelfUpdateable = requires(T u, const GameWindow &window, float deltaTime) {
-        u.Update(window, deltaTime);
-    };
-
-    void Update( SelfUpdateable auto &updateable, const GameWindow &window, float deltaTime)
-    {
-        updateable.Update(window, deltaTime);
-    }
-
-    template< typename T>
-    concept Updateable = requires(T u, const GameWindow &window, float deltaTime) {
-        Update( u, window, deltaTime);
-    };
-    template< typename T>
-    concept UpdateableRange = std::ranges::range<T> and Updateable<typename T::value_type>;
-
-    void Update( UpdateableRange auto &updateables, const GameWindow &window, float deltaTime)
-    {
-        for (auto &updateable : updateables)
-        {
-            Update( updateable, window, deltaTime);
+            Draw( drawable, renderer);
         }
     }
 
     /**
-     * Is a point inside a rectangle?
-     *
+     * Draw the clouds of the layers with a depth in [minimumDepth, maximumDepth),
+     * each through a viewport of its own that looks at the layer from the
+     * point that corresponds to where the viewport of the world looks.
      */
-    inline bool IsIn( const Vector2& point, const Rectangle& box)
+    void DrawCloudLayers(
+        const CloudSystem &clouds,
+        const Viewport &viewport,
+        WrapRenderer &renderer,
+        float minimumDepth,
+        float maximumDepth)
     {
-        return (point.x >= box.x and point.x <= box.x + box.width
-                and point.y >= box.y and point.y <= box.y + box.height);
-    }
-
-    using Collisions = std::set< std::tuple<unsigned int, unsigned int>>;
-
-    /**
-     * Find all collisions between points and collidables and return all found
-     * collisions.
-     *
-     * Each point object will appear at most once in the result and because
-     * Collisions is a set, the collisions are ordered by the point object
-     * index.
-     *
-     */
-    template< typename PointObjects, typename Collidables>
-    Collisions FindCollisions( PointObjects &points, Collidables &collidables)
-    {
-        Collisions collisions;
-        for (size_t i = 0; i < points.size(); ++i)
+        for (std::size_t index = 0; index < clouds.GetLayerCount(); ++index)
         {
-            for (size_t j = 0; j < collidables.size(); ++j)
+            const auto &layer = clouds.GetLayer( index);
+            if (layer.depth < minimumDepth or layer.depth >= maximumDepth)
             {
-                if (
-                    IsIn(GetPosition(points[i]), collidables[j].GetBoundingBox())
-                    and collidables[j].Collides( GetPosition(points[i])))
-                {
-                    collisions.emplace( i, j);
-                    continue; // Stop looking for more collisions for this point.
-                }
+                continue;
             }
+
+            // Scale by the size of the layer relative to the world rather
+            // than by the depth, which the size is rounded from, so that the
+            // layer wraps around exactly when the world does.
+            Viewport layerView( viewport.GetScreenArea(), layer.bounds);
+            const auto target = viewport.GetTarget();
+            const auto &world = viewport.GetWorld();
+            layerView.LookAt( {
+                Wrap( target.x * layer.bounds.width / world.width, static_cast<float>( layer.bounds.width)),
+                Wrap( target.y * layer.bounds.height / world.height, static_cast<float>( layer.bounds.height))});
+            layerView.Begin();
+            renderer.SetViewport( layerView);
+            clouds.DrawLayer( index, renderer);
+            renderer.Flush();
+            layerView.End();
         }
-        return collisions;
+        renderer.SetViewport( viewport);
     }
 
-void UpdateSound(Music& engine, const Plane& plane)
-{
-    SetMusicPan(engine, 0.75f - (plane.GetPosition().x / (float)initialScreenWidth)/2.0f);
-    SetMusicPitch(engine, 1.0f - (plane.GetSpeedVector().y / plane.GetSpeed()) * 0.5f);
-    UpdateMusicStream(engine);
-}
+    /// Draw whatever part of the world shows in the viewport, a layer at a time.
+    void DrawWorld( const Simulation &simulation, const Viewport &viewport, WrapRenderer &renderer)
+    {
+        const auto &clouds = simulation.GetClouds();
+        DrawCloudLayers( clouds, viewport, renderer, 0.0f, 1.0f);
+
+        viewport.Begin();
+        renderer.SetViewport( viewport);
+        Draw( simulation.GetBullets(), renderer);
+        renderer.Flush();
+        simulation.GetParticles().Draw( viewport);
+        Draw( simulation.GetPlanes(), renderer);
+        renderer.Flush();
+        viewport.End();
+
+        DrawCloudLayers( clouds, viewport, renderer, 1.0f, std::numeric_limits<float>::infinity());
+    }
 
 /**
  * This class mainly exists to own the audio assets used in the game.
  */
 struct Sounds
 {
-    Music engine = LoadMusicStream(ASSETS_PATH "engine_sound.wav");
-    Sound gun  = LoadSound(ASSETS_PATH "gun_sound.wav");
+    EngineMixer engine{ ASSETS_PATH "engine_sound.wav"};
+    GunVoicePool gun{ ASSETS_PATH "gun_sound.wav"};
     float gunVolume = 0.5f;
     float engineVolume = 0.5f;
 
-    ~Sounds()
-    {
-        UnloadMusicStream( engine);
-        UnloadSound(gun);
-    }
-
     void EnableSound(bool enableEngine, bool enableGun)
     {
-        SetSoundVolume(gun, enableGun ? gunVolume : 0.0f);
-        SetMusicVolume(engine, enableEngine ? engineVolume : 0.0f);
+        gun.SetVolume(enableGun ? gunVolume : 0.0f);
+        engine.SetVolume(enableEngine ? engineVolume : 0.0f);
     }
 };
 
+
 /**
  * Control the plane with keyboard keys.
  *
- * When the plane is upside down, it will roll until it is upright again.
+ * When no key is pressed, the plane will roll until it is upright again.
  *
  */
  struct KeyboardPlaneControl
@@ -163,78 +164,59 @@ struct Sounds
     KeyboardKey keyRight = KEY_RIGHT;
     KeyboardKey keyTrigger = KEY_SPACE;
 
-    void RollToUpright(Plane& plane)
+    PlaneInput operator()( std::size_t, float, const Plane&) const
     {
-        const auto roll = plane.GetRoll();
-        static constexpr std::int8_t rollCorrection = 4;
-        if (const auto pitch = plane.GetPitch(); pitch >= 64 and pitch < 192)
-        {
-            if (const auto roll = plane.GetRoll(); roll != 128)
-            {
-                plane.DeltaRoll(roll > 128 ? -rollCorrection : rollCorrection);
-            }
-        }
-        else
-        {
-            if (roll != 0)
-            {
-                plane.DeltaRoll(roll >= 128 ? +rollCorrection : -rollCorrection);
-            }
-        }
-    }
-
-    void operator()(
-        std::size_t planeIndex,
-        float deltaTime,
-        Plane& plane,
-        const GameWindow& window,
-        Bullets &bullets,
-        Sounds &sounds)
-    {
-        bool keyPressed = false;
+        PlaneInput input;
         if (IsKeyDown(keyRight))
         {
-            plane.DeltaPitch( 120.0 * deltaTime + 0.5f);
-            keyPressed = true;
+            input.turn = 1;
         }
         else if (IsKeyDown(keyLeft))
         {
-            plane.DeltaPitch( -120.0 * deltaTime - 0.5f);
-            keyPressed = true;
+            input.turn = -1;
         }
 
-        const auto roll = plane.GetRoll();
-        if ((not keyPressed or (roll != 0 and roll != 128))and not (plane.GetState() == Plane::Crashing))
-        {
-            RollToUpright(plane);
-        }
+        // fire a bullet when the trigger key is pressed
+        input.fire = IsKeyPressed(keyTrigger);
+        return input;
+    }
+};
 
-        // create bullets when the trigger key is pressed
-        if (IsKeyPressed(keyTrigger) and plane.GetState() == Plane::Flying)
+/**
+ * Let a computer pilot fly the plane.
+ */
+struct ComputerPlaneControl
+{
+    const AiPilots *pilots;
 
-        {
-            if (plane.Fire( bullets))
-            {
-                SetSoundPan( sounds.gun, 1.0f - (plane.GetPosition().x / (float)initialScreenWidth)/2.0f);
-                PlaySound(sounds.gun);
-            }
-        }
+    PlaneInput operator()( std::size_t planeIndex, float deltaTime, const Plane &plane) const
+    {
+        return pilots->GetInput( planeIndex, deltaTime, plane);
     }
 };
 
 /**
- * A 'control' strategy that does not allow the user to control the plane, but rather lets the plane
- *
+ * Fly the plane as it was flown when the replay was recorded, with the input
+ * of the tick that the replay has just read.
+ */
+struct ReplayPlaneControl
+{
+    const ReplayFile *replay;
+
+    PlaneInput operator()( std::size_t planeIndex, float, const Plane&) const
+    {
+        const auto inputs = replay->GetInputs();
+        return planeIndex < inputs.size() ? inputs[planeIndex] : PlaneInput{};
+    }
+};
+
+/**
+ * The ways in which a plane can be controlled. Each of them turns what a
+ * player wants into a PlaneInput for the current tick, without touching the
+ * plane or making sounds. Being a variant rather than a type-erased function,
+ * a call is a switch over the alternatives that the compiler can inline.
  */
-using PlaneControl =
-    std::function<
-        void(
-            std::size_t planeIndex,
-            float deltaTime,
-            Plane&,
-            const GameWindow&,
-            Bullets&,
-            Sounds&)>;
+using PlaneControl = std::variant< KeyboardPlaneControl, ComputerPlaneControl, ReplayPlaneControl>;
 
 /**
  * This class is used to initialize and close the audio device.
@@ -253,17 +235,24 @@ using PlaneControl =
 };
 
 /**
- * The Game object is a singleton that holds all the game objects, such as
- * planes, bullets and clouds. It also initializes relevant parts of raylib.
+ * The Game object is a singleton that holds the simulation of the world, with
+ * all the game objects such as planes, bullets and clouds, and the players
+ * that control the planes. It also initializes relevant parts of raylib.
  *
  * This object also implements the game frame update and draw functions.
  */
 struct Game : public GameAudio, public GameWindow
 {
 public:
-    static Game &GetInstance()
+    /**
+     * The size of the world and the random seed for the sky only count for
+     * the first call, which creates the game.
+     */
+    static Game &GetInstance(
+        WorldBounds world = { initialScreenWidth, initialScreenHeight},
+        unsigned int skySeed = static_cast<unsigned int>( std::time( nullptr)))
     {
-        static Game instance;
+        static Game instance( world, skySeed);
         return instance;
     }
 
@@ -273,90 +262,207 @@ public:
     Game& operator=(Game&&)         = delete;
     ~Game()                         = default;
 
-    Plane &GetPlane() { return planes[0]; }
+    Plane &GetPlane() { return simulation.GetPlanes()[0]; }
 
 
     /**
-    * Update the world state.
+    * Update the world state by the given number of seconds.
     */
-    void Update()
+    void Update( float deltaTime)
     {
-        using ::Update;
-        const float deltaTime = GetFrameTime();
+        auto &planes = simulation.GetPlanes();
 
         // First, do updates.
-        // figure out screen size
+        // figure out screen size and what each view shows.
         GameWindow::Update();
-        HandleGameMechanics();
+        LayOutViews();
+        frameEvents.clear();
+        if (replay)
+        {
+            allocationTracker.BeginPhase( FramePhase::Physics);
+            PlayReplay( deltaTime);
+        }
+        else
+        {
+            Play( deltaTime);
+        }
+
+        // Let the cameras follow the planes.
+        for (auto &view : views)
+        {
+            const auto &plane = planes[view.plane];
+            if (view.follows and (plane.GetState() == Plane::Flying or plane.GetState() == Plane::Newborn))
+            {
+                view.viewport.Follow( plane.GetPosition(), deltaTime);
+            }
+        }
+
+        // adapt the sounds to what is happening, as heard from the middle of each view.
+        allocationTracker.BeginPhase( FramePhase::Sound);
+        std::array< Vector2, 2> listenerPositions;
+        const std::size_t listenerCount = std::min( views.size(), listenerPositions.size());
+        for (std::size_t i = 0; i < listenerCount; ++i)
+        {
+            listenerPositions[i] = views[i].viewport.GetTarget();
+        }
+        const auto screenArea = views.front().viewport.GetScreenArea();
+        const Listeners listeners = {
+            std::span( listenerPositions.data(), listenerCount),
+            std::hypot( screenArea.width, screenArea.height) / 2.0f};
+        sounds.gun.Play( frameEvents, simulation.GetBounds(), listeners, GetTime());
+        sounds.engine.Update( planes, simulation.GetBounds(), listeners);
+    }
+
+    /// Let the players fly their planes for a tick.
+    void Play( float deltaTime)
+    {
+        auto &planes = simulation.GetPlanes();
+        if (recorder)
+        {
+            recorder->BeginTick( simulation);
+        }
 
         // let players control their planes
+        allocationTracker.BeginPhase( FramePhase::Controls);
+        pilots.Think( simulation);
         assert(players.size() == planes.size());
         for (std::size_t i = 0; i < players.size(); ++i)
         {
-            players[i].control( i, deltaTime, planes[i], *this, bullets, sounds);
+            inputs[i] = std::visit(
+                [&]( const auto &control) { return control( i, deltaTime, planes[i]); },
+                players[i].control);
+        }
+        if (latencyProbe)
+        {
+            for (std::size_t i = 0; i < players.size(); ++i)
+            {
+                if (std::holds_alternative<KeyboardPlaneControl>( players[i].control))
+                {
+                    latencyProbe->SampleInput( i, inputs[i].turn, planes[i].GetFinePitch(), pacer.GetInputTime());
+                }
+            }
+        }
+        if (recorder)
+        {
+            recorder->RecordInputs( inputs, deltaTime);
         }
 
-        // Do physics.
-        Update( planes, *this, deltaTime);
-        Update( bullets, *this, deltaTime);
-        Update( clouds, *this, deltaTime);
+        // Do the rules, the physics and the physics that go bang.
+        allocationTracker.BeginPhase( FramePhase::Physics);
+        simulation.Tick( inputs, deltaTime);
+        CollectEvents();
 
-        // Do physics that go bang.
-        DoCollisions();
+        if (latencyProbe)
+        {
+            for (std::size_t i = 0; i < players.size(); ++i)
+            {
+                latencyProbe->EndTick( i, simulation.GetTick(), planes[i]);
+            }
+        }
+    }
 
+    /**
+     * Play the replay at the speed at which it was recorded, whatever the
+     * frame rate, or scrub through it: the right arrow key fast-forwards, the
+     * left one rewinds, space pauses and home goes back to the start.
+     */
+    void PlayReplay( float deltaTime)
+    {
+        constexpr float scrubSpeed = 8.0f;
+        if (IsKeyPressed( KEY_SPACE))
+        {
+            replayPaused = not replayPaused;
+        }
+        if (IsKeyPressed( KEY_HOME))
+        {
+            replay->Seek( simulation, 0, replayCursor);
+            replayLag = 0.0f;
+        }
+        if (IsKeyDown( KEY_LEFT))
+        {
+            // Assume that the earlier ticks took as long as the last one.
+            const float tickTime = replayCursor.deltaTime > 0.0f ? replayCursor.deltaTime : deltaTime;
+            const auto ticks = static_cast<std::uint64_t>( std::lround( scrubSpeed * deltaTime / tickTime));
+            replay->Seek( simulation, replayCursor.tick - std::min( replayCursor.tick, ticks), replayCursor);
+            replayLag = 0.0f;
+            return;
+        }
 
+        // Play the ticks that the replay is behind on the frame, each as long
+        // as it took when it was recorded, with the players' controls reading
+        // the recorded inputs.
+        replayLag += IsKeyDown( KEY_RIGHT) ? scrubSpeed * deltaTime : replayPaused ? 0.0f : deltaTime;
+        while (replayLag > 0.0f and replay->ReadTick( replayCursor))
+        {
+            replayLag -= replayCursor.deltaTime;
+            Play( replayCursor.deltaTime);
+        }
+    }
 
-        // adapt the sounds to what is happening.
-        UpdateSound(sounds.engine, planes[0]);
+    /**
+     * Keep the events of the tick that was just played for the rest of the
+     * frame. The simulation forgets them at the start of its next tick, and
+     * a frame of a replay can play several ticks.
+     */
+    void CollectEvents()
+    {
+        const auto &events = simulation.GetEvents();
+        frameEvents.reserve( std::max( frameEvents.capacity(), events.capacity()));
+        frameEvents.insert( frameEvents.end(), events.begin(), events.end());
     }
 
-    void HandleGameMechanics()
+    void DrawReplayProgress()
     {
-        // reset planes that are in crashed state
-        for (auto& plane : planes)
-        {
-            if (plane.GetState() == Plane::Crashed)
-            {
-                plane.Reset({ width / 2.0f, height / 2.0f }, 220, 0);
-            }
-        }
+        const int fontSize = 20;
+        const char *text = TextFormat(
+            "replay %llu / %llu%s",
+            static_cast<unsigned long long>( replayCursor.tick),
+            static_cast<unsigned long long>( replay->GetTickCount()),
+            replayPaused ? ", paused" : "");
+        DrawText( text, (width - MeasureText( text, fontSize)) / 2, height - 2 * fontSize, fontSize, DARKGRAY);
     }
 
-    std::string FormatScore(int score)
+    /**
+     * Format a score with leading zeros.
+     *
+     * The result lives in one of raylib's internal TextFormat() buffers, so it
+     * is only valid until a few more calls to TextFormat() have been made.
+     */
+    const char *FormatScore(int score)
     {
-        return (std::ostringstream() << std::setw(2) << std::setfill('0') << score). str();
+        return TextFormat( "%02d", score);
     }
 
     void DrawScore()
     {
-
+        const auto &planes = simulation.GetPlanes();
 
         const int fontSize = 50;
         const int offset = 20;
         const int dropShadowOffset = 3;
 
-        // Format scores with leading zeros using std::format
-        const std::string score0 = FormatScore( players[0].score);
-        const std::string score1 = FormatScore( players[1].score);
+        // Format scores with leading zeros
+        const char *score0 = FormatScore( simulation.GetScore( 0));
+        const char *score1 = FormatScore( simulation.GetScore( 1));
 
-        int textWidth = MeasureText(score1.c_str(), fontSize);
+        int textWidth = MeasureText(score1, fontSize);
 
 
         // Draw drop shadow for player 0's score
-        DrawText(score0.c_str(), offset + dropShadowOffset, offset + dropShadowOffset, fontSize, Fade( GRAY, 0.5f));
+        DrawText(score0, offset + dropShadowOffset, offset + dropShadowOffset, fontSize, Fade( GRAY, 0.5f));
         // Draw player 0's score in the top left corner
-        DrawText(score0.c_str(), offset, offset, fontSize, planes[0].GetColor());
+        DrawText(score0, offset, offset, fontSize, planes[0].GetColor());
 
         // Draw drop shadow for player 1's score
-        DrawText(score1.c_str(), width - textWidth - offset + dropShadowOffset, offset + dropShadowOffset, fontSize, GRAY);
+        DrawText(score1, width - textWidth - offset + dropShadowOffset, offset + dropShadowOffset, fontSize, GRAY);
         // Draw player 1's score in the top right corner
-        DrawText(score1.c_str(), width - textWidth - offset, offset, fontSize, planes[1].GetColor());
+        DrawText(score1, width - textWidth - offset, offset, fontSize, planes[1].GetColor());
 
         // Draw the bullet count for plane 0 directly below the score
-        planes[0].DrawBulletCount(*this, { offset, offset + fontSize + 10.0f });
+        planes[0].DrawBulletCount(*this, { offset, offset + fontSize + 10.0f }, simulation.GetTime());
 
         // Draw the bullet count for plane 1 directly below the score
-        planes[1].DrawBulletCount(*this, { static_cast<float>(width - textWidth - offset), offset + fontSize + 10.0f });
+        planes[1].DrawBulletCount(*this, { static_cast<float>(width - textWidth - offset), offset + fontSize + 10.0f }, simulation.GetTime());
 
 
     }
@@ -366,24 +472,128 @@ public:
     */
     void Draw()
     {
-        using ::Draw;
-
         // All physics and interactions are done, now draw the frame.
         BeginDrawing();
         ClearBackground(SKYBLUE);
 
-        Draw( bullets, *this);
-        Draw( planes, *this);
-        Draw( clouds, *this);
+        for (const auto &view : views)
+        {
+            DrawWorld( simulation, view.viewport, renderer);
+        }
+        for (std::size_t index = 1; index < views.size(); ++index)
+        {
+            const auto area = views[index].viewport.GetScreenArea();
+            DrawRectangle( static_cast<int>( area.x) - 1, 0, 2, height, DARKGRAY);
+        }
         DrawScore();
+        if (replay)
+        {
+            DrawReplayProgress();
+        }
+
+        if (IsDrawingPlaneDebugIndicators())
+        {
+            DrawDebugOverlay();
+            DrawFrameTelemetry( telemetry, { width / 2.0f - 100.0f, 10.0f});
+        }
+
+        // Stop measuring before presenting, which may also wait for the next frame.
+        telemetry.EndDraw();
+        pacer.EndFrame();
+    }
+
+    /**
+     * Draw diagnostic information about the previous frame in the bottom
+     * left corner of the screen.
+     */
+    void DrawDebugOverlay() const
+    {
+        const int fontSize = 10;
+        const int lineHeight = fontSize + 2;
+        const int left = 10;
+        int top = height - 10 - (static_cast<int>(FramePhase::Count) + 1) * lineHeight;
 
-        EndDrawing();
+        if constexpr (not AllocationTracker::enabled)
+        {
+            DrawText( "allocation tracking disabled", left, top, fontSize, BLACK);
+            return;
+        }
+
+        const auto &frame = allocationTracker.GetFrameCounts();
+        DrawText(
+            TextFormat( "heap: %zu allocations, %zu bytes per frame", frame.allocations, frame.bytes),
+            left, top, fontSize, frame.allocations ? RED : BLACK);
+        for (std::size_t phaseIndex = 0; phaseIndex < static_cast<std::size_t>(FramePhase::Count); ++phaseIndex)
+        {
+            top += lineHeight;
+            const auto phase = static_cast<FramePhase>(phaseIndex);
+            const auto &counts = allocationTracker.GetPhaseCounts( phase);
+            DrawText(
+                TextFormat( "  %-10s %zu allocations, %zu bytes", GetPhaseName( phase), counts.allocations, counts.bytes),
+                left, top, fontSize, counts.allocations ? RED : BLACK);
+        }
     }
 
     void UpdateAndDraw()
     {
-        Update();
+        pacer.BeginFrame();
+        const float deltaTime = pacer.GetFrameTime();
+        allocationTracker.BeginFrame();
+        telemetry.BeginFrame( deltaTime);
+        Update( deltaTime);
+        telemetry.EndUpdate();
+        allocationTracker.BeginPhase( FramePhase::Draw);
         Draw();
+        telemetry.RecordLatency( pacer.GetInputLatency());
+        if (latencyProbe)
+        {
+            latencyProbe->EndFrame( pacer.GetPresentTime());
+        }
+        allocationTracker.EndFrame();
+    }
+
+    FrameTelemetry &GetTelemetry() { return telemetry; }
+
+    /**
+     * Start or stop measuring the latency from the keyboard to the screen,
+     * see InputLatencyProbe. Starting again starts from scratch. With a CSV
+     * path, every measured input edge is also written to that file.
+     */
+    void MeasureInputLatency( bool measure, const char *csvPath = nullptr)
+    {
+        latencyProbe = measure ? std::make_unique<InputLatencyProbe>( csvPath) : nullptr;
+    }
+
+    /// Null when input latency is not being measured.
+    const InputLatencyProbe *GetInputLatencyProbe() const { return latencyProbe.get(); }
+
+    const AllocationTracker &GetAllocationTracker() const { return allocationTracker; }
+
+    /**
+     * Report the allocations of the last frame, per phase, to the log.
+     */
+    void LogFrameAllocations() const
+    {
+        for (std::size_t phaseIndex = 0; phaseIndex < static_cast<std::size_t>(FramePhase::Count); ++phaseIndex)
+        {
+            const auto phase = static_cast<FramePhase>(phaseIndex);
+            const auto &counts = allocationTracker.GetPhaseCounts( phase);
+            if (counts.allocations)
+            {
+                TraceLog(
+                    LOG_WARNING, "ALLOC: frame %zu, phase %s: %zu allocations, %zu bytes",
+                    allocationTracker.GetFrameCount() - 1, GetPhaseName( phase), counts.allocations, counts.bytes);
+            }
+        }
+    }
+
+    /**
+     * Do not count allocations in the first frames, when containers are still
+     * growing towards their steady state capacity.
+     */
+    void SetAllocationWarmupFrames( std::size_t frames)
+    {
+        allocationTracker.SetWarmupFrames( frames);
     }
 
     void EnableSound(bool enableEngine, bool enableGun)
@@ -391,59 +601,154 @@ public:
         sounds.EnableSound(enableEngine, enableGun);
     }
 
-private:
-    Game()
-    :
-    GameWindow( initialScreenWidth, initialScreenHeight, "Combatants"),
-    planes{{
-        {0, "green", DARKGREEN, { initialScreenWidth / 2.0f + 20, initialScreenHeight / 2.0f}, 220, 128},
-        {1, "red", RED, { initialScreenWidth / 2.0f - 20, initialScreenHeight / 2.0f}, 220, 0}}}
+    /// Record the game to a replay file.
+    void Record( const char *path)
     {
-        PlayMusicStream( sounds.engine);
+        recorder = std::make_unique<ReplayRecorder>( path, ReplayInfo{
+            simulation.GetBounds(),
+            static_cast<std::uint32_t>( simulation.GetPlanes().size()),
+            skySeed,
+            ReplayRecorder::defaultKeyframeInterval});
     }
 
-    void DoCollisions()
+    /// Write the gameplay events to a log for analytics, see EventLog.
+    void LogEvents( const char *path)
     {
-        const auto collisions = FindCollisions( bullets, planes);
+        eventLog = std::make_unique<EventLog>( path);
+        simulation.SetEventLog( eventLog.get());
+    }
 
-        // we assume that:
-        // 1. collisions are ordered by the index of the bullet
-        // 2. each bullet occurs only once in the list of collisions
-        // These assumptions must be guaranteed by the FindCollisions function.
-        int bulletIndexOffset = 0;
-        for (const auto& collision : collisions)
+    /**
+     * Watch a replay instead of playing: all planes fly as they were
+     * recorded. The game must have been created with the world and sky seed
+     * of the replay. Returns false if the replay does not fit the game.
+     */
+    bool Watch( std::unique_ptr<ReplayFile> file)
+    {
+        replay = std::move( file);
+        replayLag = 0.0f;
+        for (auto &player : players)
         {
-            const auto bulletIndex = std::get<0>(collision);
-            const auto planeIndex  = std::get<1>(collision);
-            if (
-                bullets[bulletIndex].GetOwner() != planeIndex
-                and planes[planeIndex].GetState() == Plane::Flying)
+            player.control = ReplayPlaneControl{ replay.get()};
+        }
+        return replay->Seek( simulation, 0, replayCursor);
+    }
+
+    /// Replace the control of a plane with a computer pilot.
+    void LetComputerFly( std::size_t planeIndex)
+    {
+        pilots.AddPilot( planeIndex);
+        players[planeIndex].control = ComputerPlaneControl{ &pilots};
+    }
+
+    /**
+     * Show the whole world in a single view if it fits in the window.
+     * Otherwise, split the window between the players at the keyboard, or
+     * those of a replay, with a view for each that follows their plane.
+     */
+    void LayOutViews()
+    {
+        const auto &world = simulation.GetBounds();
+        const bool fits = world.width <= width and world.height <= height;
+
+        std::array< std::size_t, 2> followed = {};
+        std::size_t count = 0;
+        for (std::size_t index = 0; not fits and index < players.size(); ++index)
+        {
+            if (not std::holds_alternative<ComputerPlaneControl>( players[index].control))
             {
-                // A bullet of one player has hit a plane of the other player.
-                bullets.erase( bullets.begin() + bulletIndex + bulletIndexOffset);
-                planes[planeIndex].SetState(Plane::Crashing);
-                --bulletIndexOffset;
+                followed[count++] = index;
+            }
+        }
+        const bool follows = count != 0;
+        count = std::max<std::size_t>( count, 1);
 
-                players[ bullets[bulletIndex].GetOwner()].score += 1;
+        bool changed = views.size() != count;
+        for (std::size_t index = 0; not changed and index < count; ++index)
+        {
+            changed = views[index].plane != followed[index] or views[index].follows != follows;
+        }
+        if (changed)
+        {
+            views.clear();
+            for (std::size_t index = 0; index < count; ++index)
+            {
+                auto &view = views.emplace_back( View{ Viewport( {}, world), followed[index], follows});
+                if (follows)
+                {
+                    view.viewport.LookAt( simulation.GetPlanes()[followed[index]].GetPosition());
+                }
             }
         }
+
+        const float viewWidth = static_cast<float>( width) / count;
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            views[index].viewport.SetScreenArea( { index * viewWidth, 0.0f, viewWidth, static_cast<float>( height)});
+        }
+    }
+
+private:
+    Game( WorldBounds world, unsigned int skySeed)
+    :
+    GameWindow( initialScreenWidth, initialScreenHeight, "Combatants"),
+    telemetry( pacer.GetRefreshRate()),
+    simulation( world, CreateClouds( world, skySeed)),
+    skySeed( skySeed)
+    {
+        // Start the planes flying away from each other, as they do when they respawn.
+        simulation.AddPlane( "green", DARKGREEN, Vector2{ world.width / 2.0f + 20, world.height / 2.0f}, 220, 0);
+        simulation.AddPlane( "red", RED, Vector2{ world.width / 2.0f - 20, world.height / 2.0f}, 220, 128);
+
+    }
+
+    /// As many clouds per area in the layer of the planes as in a world of the initial window size.
+    static CloudSystem CreateClouds( WorldBounds world, unsigned int seed)
+    {
+        // Creating the window seeds the random generator with the time, seed
+        // it here so that replays can create the same sky.
+        SetRandomSeed( seed);
+
+        const float area = static_cast<float>( world.width) * world.height;
+        CloudLayerSettings flyingLayer;
+        flyingLayer.clouds = std::max( 1, static_cast<int>( 4 * area / (initialScreenWidth * initialScreenHeight)));
+        return CreateRandomSky( world, flyingLayer);
     }
 
     struct Player
     {
         PlaneControl control;
-        int score = 0;
     };
 
+    struct View
+    {
+        Viewport    viewport;
+        std::size_t plane;      ///< the plane that the view follows
+        bool        follows;    ///< whether the view follows a plane, rather than showing the middle of the world
+    };
+
+    AllocationTracker       allocationTracker;
+    FramePacer              pacer;
+    FrameTelemetry          telemetry;
     Sounds                  sounds;
     std::array< Player, 2>  players = {
         Player{KeyboardPlaneControl( KEY_LEFT, KEY_RIGHT, KEY_SPACE)},
         Player{KeyboardPlaneControl( KEY_A, KEY_D, KEY_LEFT_SHIFT)}
     };
-    std::array<Plane, 2>    planes;
-    Bullets                 bullets;
-    CloudSystem             clouds = CreateRandomCloudSystem(
-        4, 24, 50.0f/1024, 0.9f);
+    std::array< PlaneInput, 2> inputs;
+    Simulation              simulation;
+    AiPilots                pilots;
+    std::vector< View>      views;
+    std::vector< GameEvent> frameEvents;    ///< of all ticks played during the frame
+    WrapRenderer            renderer;
+    unsigned int            skySeed;
+    std::unique_ptr<ReplayRecorder> recorder;
+    std::unique_ptr<ReplayFile>     replay;
+    std::unique_ptr<EventLog>       eventLog;
+    std::unique_ptr<InputLatencyProbe> latencyProbe;
+    ReplayFile::Cursor      replayCursor;
+    bool                    replayPaused = false;
+    float                   replayLag = 0.0f;   ///< seconds of the replay that are due but have not been played
 };
 
 void UpdateDrawFrame()
@@ -466,24 +771,215 @@ extern "C" {
     {
         DrawPlaneDebugIndicators( draw);
     }
+
+    /// Returns a JSON summary of the frame timing statistics since the last reset.
+    const char *GetFrameTelemetry()
+    {
+        return FormatFrameTelemetry( Game::GetInstance().GetTelemetry());
+    }
+
+    void ResetFrameTelemetry()
+    {
+        Game::GetInstance().GetTelemetry().Reset();
+    }
+
+    void MeasureInputLatency( bool measure)
+    {
+        Game::GetInstance().MeasureInputLatency( measure);
+    }
+
+    /// Returns a JSON summary of the input latency since measuring started, or an empty object when not measuring.
+    const char *GetInputLatency()
+    {
+        const auto *probe = Game::GetInstance().GetInputLatencyProbe();
+        return probe ? FormatInputLatency( *probe) : "{}";
+    }
 }
 
 #endif // EMSCRIPTEN
 
-int main(void)
+int main(int argc, char *argv[])
 {
-    auto &game = Game::GetInstance();
+    // With --allocation-gate, the game runs for a fixed number of frames and
+    // fails if any frame after the warm-up period allocates heap memory.
+    // With --ai, the computer flies the red plane, unless a replay is watched.
+    // With --world <width>x<height>, the world has the given size rather than
+    // the size of the initial window. Players get a view each that follows
+    // their plane if the world does not fit in the window.
+    // With --scenario <file>, the game does not open a window but runs the
+    // given stress scenario headless and writes CSV to --csv <file> or stdout.
+    // With --record <file>, the game is recorded to a replay file, which
+    // --replay <file> plays back.
+    // With --event-log <file>, the gameplay events are logged to a file, of
+    // which --event-report <file> writes the statistics per player as CSV to
+    // --csv <file> or stdout.
+    // With --input-latency, the time from turning with the keyboard until
+    // the frame that shows the turn is presented is measured and logged on
+    // exit, and written per input edge to --csv <file> if given.
+    bool allocationGate = false;
+    bool computerOpponent = false;
+    bool inputLatency = false;
+    WorldBounds world = { initialScreenWidth, initialScreenHeight};
+    const char *scenarioPath = nullptr;
+    const char *csvPath = nullptr;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    const char *eventLogPath = nullptr;
+    const char *eventReportPath = nullptr;
+    for (int argument = 1; argument < argc; ++argument)
+    {
+        const std::string_view option = argv[argument];
+        if (option == "--allocation-gate")
+        {
+            allocationGate = true;
+        }
+        else if (option == "--ai")
+        {
+            computerOpponent = true;
+        }
+        else if (option == "--input-latency")
+        {
+            inputLatency = true;
+        }
+        else if (option == "--world" and argument + 1 < argc)
+        {
+            WorldBounds size = {};
+            if (std::sscanf( argv[++argument], "%dx%d", &size.width, &size.height) == 2 and size.width > 0 and size.height > 0)
+            {
+                world = size;
+            }
+            else
+            {
+                TraceLog( LOG_WARNING, "Ignoring invalid world size %s", argv[argument]);
+            }
+        }
+        else if (option == "--scenario" and argument + 1 < argc)
+        {
+            scenarioPath = argv[++argument];
+        }
+        else if (option == "--csv" and argument + 1 < argc)
+        {
+            csvPath = argv[++argument];
+        }
+        else if (option == "--record" and argument + 1 < argc)
+        {
+            recordPath = argv[++argument];
+        }
+        else if (option == "--replay" and argument + 1 < argc)
+        {
+            replayPath = argv[++argument];
+        }
+        else if (option == "--event-log" and argument + 1 < argc)
+        {
+            eventLogPath = argv[++argument];
+        }
+        else if (option == "--event-report" and argument + 1 < argc)
+        {
+            eventReportPath = argv[++argument];
+        }
+    }
+
+    if (scenarioPath)
+    {
+        return RunScenario( scenarioPath, csvPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (eventReportPath)
+    {
+        return ReportEventLog( eventReportPath, csvPath) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (allocationGate and not AllocationTracker::enabled)
+    {
+        TraceLog( LOG_ERROR, "ALLOC: --allocation-gate requires a build with PLANES_TRACK_ALLOCATIONS");
+        return EXIT_FAILURE;
+    }
+
+    // A replay brings the world and the sky that it was recorded in.
+    auto skySeed = static_cast<unsigned int>( std::time( nullptr));
+    std::unique_ptr<ReplayFile> replay;
+    if (replayPath)
+    {
+        replay = std::make_unique<ReplayFile>( replayPath);
+        if (not replay->IsOpen())
+        {
+            return EXIT_FAILURE;
+        }
+        world = replay->GetInfo().world;
+        skySeed = replay->GetInfo().seed;
+    }
+
+    auto &game = Game::GetInstance( world, skySeed);
     game.EnableSound( false, true);
+    if (replay)
+    {
+        if (not game.Watch( std::move( replay)))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    else if (recordPath)
+    {
+        game.Record( recordPath);
+    }
+    if (eventLogPath)
+    {
+        game.LogEvents( eventLogPath);
+    }
+    if (computerOpponent and not replayPath)
+    {
+        game.LetComputerFly( 1);
+    }
+    if (inputLatency)
+    {
+        game.MeasureInputLatency( true, csvPath);
+    }
 
 #if defined( EMSCRIPTEN)
     emscripten_set_main_loop(UpdateDrawFrame, 0, 1);
 #else
 
-    SetTargetFPS(60);
+    constexpr std::size_t allocationWarmupFrames = 120;
+    constexpr std::size_t allocationGateFrames = 600;
+    game.SetAllocationWarmupFrames( allocationWarmupFrames);
+
+    // Without custom frame control in raylib, EndDrawing() waits for the
+    // next frame, otherwise the frame pacer does.
+    if constexpr (not FramePacer::enabled)
+    {
+        SetTargetFPS(60);
+    }
 
+    const auto &tracker = game.GetAllocationTracker();
     while (!WindowShouldClose())
     {
         game.UpdateAndDraw();
+
+        if (allocationGate)
+        {
+            if (tracker.GetFrameCount() > allocationWarmupFrames and tracker.GetFrameCounts().allocations)
+            {
+                game.LogFrameAllocations();
+            }
+            if (tracker.GetFrameCount() >= allocationGateFrames)
+            {
+                break;
+            }
+        }
+    }
+
+    if (allocationGate)
+    {
+        const auto failedFrames = tracker.GetAllocatingFrameCount();
+        TraceLog(
+            failedFrames ? LOG_ERROR : LOG_INFO, "ALLOC: %zu of %zu steady state frames allocated heap memory",
+            failedFrames, tracker.GetFrameCount() - allocationWarmupFrames);
+        return failedFrames ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    TraceLog( LOG_INFO, "TELEMETRY: %s", FormatFrameTelemetry( game.GetTelemetry()));
+    if (const auto *probe = game.GetInputLatencyProbe())
+    {
+        TraceLog( LOG_INFO, "LATENCY: %s", FormatInputLatency( *probe));
     }
 
 #endif // EMSCRIPTEN